@@ -0,0 +1,33 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Casemap.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 08:16:57 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 08:16:57 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Casemap.hpp"
+
+std::string ircLower(const StringView &name)
+{
+    std::string folded(name.size(), '\0');
+    for (size_t i = 0; i < name.size(); i++)
+        folded[i] = ircFold(name[i]);
+    return (folded);
+}
+
+bool ircEquals(const StringView &a, const StringView &b)
+{
+    if (a.size() != b.size())
+        return (false);
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (ircFold(a[i]) != ircFold(b[i]))
+            return (false);
+    }
+    return (true);
+}
@@ -0,0 +1,30 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Casemap.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 08:16:57 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 10:23:14 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CASEMAP_HPP
+# define CASEMAP_HPP
+
+# include "StringView.hpp"
+# include <string>
+
+// RFC 1459 casemapping: A-Z and []\^ fold to a-z and {}|~
+inline char	ircFold(char c)
+{
+	if ((c >= 'A' && c <= 'Z') || c == '[' || c == ']' || c == '\\' || c == '^')
+		return static_cast<char>(c + 32);
+	return c;
+}
+
+std::string	ircLower(const StringView &name);
+bool		ircEquals(const StringView &a, const StringView &b);
+
+#endif
@@ -14,52 +14,92 @@
 # define CHANNEL_HPP
 
 # include "Client.hpp"
-# include "Server.hpp"
-# include <set>
+# include "Casemap.hpp"
+# include <algorithm>
 # include <string>
+# include <vector>
 
-# define MAX_CLIENTS 1000
+# define MEMBER_OP		0x01
+# define MEMBER_VOICE	0x02
+
+// Advertised in RPL_ISUPPORT, MODES caps the parameter-taking changes per line
+# define CHANNEL_MODES	"itklov"
+# define MAX_MODES		3
+
+struct ModeChange
+{
+	char		sign;
+	char		mode;
+	std::string	parameter;
+};
+
+// Kept sorted by fd so fan-out is a linear scan and lookups are a binary search.
+// Live fds are unique across shards, so the fd still orders members from all of them
+struct Membership
+{
+	ClientRef		ref;
+	unsigned char	flags;
+};
+
+class ChannelRegistry;
 
 class Channel
 {
+	friend class ChannelRegistry;
+
 	private:
 		std::string		name;
-		std::set<int>	members;
-		std::set<int>	operators;
+		const std::string	*foldedName;
+		std::vector<Membership>	members;
+		// What WHO, KICK and MODE know of members[i], kept apart so fan-out only walks the refs
+		std::vector<SharedCard>	cards;
 		bool			inviteOnly = false;
 		std::string		topic;
 		bool			topicProtected = false;
 		std::string		key;
-		int				userLimit = MAX_CLIENTS;
-		std::set<int>	invitedUsers;
+		int				userLimit = 0;
+		std::vector<ClientRef>	invitedUsers;
+
+		std::vector<Membership>::iterator		findMember(const ClientRef &ref);
+		std::vector<Membership>::const_iterator	findMember(const ClientRef &ref) const;
+		void									setFlag(const ClientRef &ref, unsigned char flag, bool enabled);
 
 	public:
-		Channel(const std::string &name) : name(name) {}
+		explicit Channel(const std::string &name) : name(name), foldedName(NULL) {}
 		~Channel() {}
-		Channel(const Channel &) = default;
-		Channel &operator=(const Channel &) = default;
+		Channel(const Channel &) = delete;
+		Channel &operator=(const Channel &) = delete;
+		Channel(Channel &&) = default;
+		Channel &operator=(Channel &&) = default;
 		
 		const std::string	&getName() const { return name; }
+		const std::string	&getFoldedName() const { return *foldedName; }
 		const std::string	&getTopic() const { return topic; }
 		bool				isInviteOnly() const { return inviteOnly; }
 		bool				isTopicProtected() const { return topicProtected; }
 		int					getUserLimit() const { return userLimit; }
 
-		void				addMember(int clientFd) { members.insert(clientFd); }
-		void				removeMember(int clientFd);
-		bool				isMember(int clientFd) const { return members.find(clientFd) != members.end(); }
-		const std::set<int>	&getMembers() const { return members; }
+		void							addMember(const SharedCard &card, unsigned char flags = 0);
+		void							removeMember(const ClientRef &ref);
+		bool							isMember(const ClientRef &ref) const { return findMember(ref) != members.end(); }
+		const ClientCard				*findMemberByNick(const std::string &nickname) const;
+		void							updateCard(const SharedCard &card);
+		const std::vector<Membership>	&getMembers() const { return members; }
+		const std::vector<SharedCard>	&getCards() const { return cards; }
 		
-		void				addOperator(int clientFd) { operators.insert(clientFd); }
-		void				removeOperator(int clientFd) { operators.erase(clientFd); }
-		bool				isOperator(int clientFd) const { return operators.find(clientFd) != operators.end(); }
+		void				addOperator(const ClientRef &ref) { setFlag(ref, MEMBER_OP, true); }
+		void				removeOperator(const ClientRef &ref) { setFlag(ref, MEMBER_OP, false); }
+		bool				isOperator(const ClientRef &ref) const;
+		void				addVoice(const ClientRef &ref) { setFlag(ref, MEMBER_VOICE, true); }
+		void				removeVoice(const ClientRef &ref) { setFlag(ref, MEMBER_VOICE, false); }
 
 		void				setTopic(const std::string &newTopic) { topic = newTopic; }
 		void				setInviteOnly(bool inviteOnly) { this->inviteOnly = inviteOnly; }
 		void				setTopicProtected(bool topicProtected) { this->topicProtected = topicProtected; }
 		
-		void				inviteUser(int clientFd) { invitedUsers.insert(clientFd); }
-		bool				isInvited(int clientFd) const { return invitedUsers.find(clientFd) != invitedUsers.end(); }
+		void				inviteUser(const ClientRef &ref);
+		void				uninviteUser(const ClientRef &ref);
+		bool				isInvited(const ClientRef &ref) const;
 		
 		void				setKey(const std::string &newKey) { key = newKey; }
 		void				clearKey() { key.clear(); }
@@ -67,8 +107,8 @@ class Channel
 		const std::string	&getKey() const { return key; }
 
 		void				setUserLimit(int limit) { userLimit = limit; }
-		void				clearUserLimit() { userLimit = MAX_CLIENTS; }
-		bool				userLimitReached() const { return static_cast<int>(members.size()) >= userLimit; }	
+		void				clearUserLimit() { userLimit = 0; }
+		bool				userLimitReached() const { return userLimit > 0 && static_cast<int>(members.size()) >= userLimit; }	
 };
 
 #endif
\ No newline at end of file
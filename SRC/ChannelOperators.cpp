@@ -18,141 +18,165 @@
 
 Channel *Server::getChannel(const std::string &channelName)
 {
-	auto it = channels.find(channelName);
-	if (it != channels.end())
-		return (&it->second);
-	return (nullptr);
+	return (channels.find(channelName));
 }
 
 Client	*Server::getClient(int clientFd)
 {
-	auto it = std::find_if(clients.begin(), clients.end(), [clientFd](const Client &client) {
-		return (client.getClientFd() == clientFd);
-	});
-	if (it != clients.end())
-		return (&(*it));
-	return (nullptr);
-}
-
-Client *Server::getClientByNickname(const std::string &nickname)
-{
-	auto it = std::find_if(clients.begin(), clients.end(), [&nickname](const Client &client) {
-		return (client.getNickname() == nickname);
-	});
-	if (it != clients.end())
-		return (&(*it));
+	Connection *connection = connections.get(clientFd);
+	if (connection)
+		return (&connection->client);
 	return (nullptr);
 }
 
+// On the channel's shard; a target that is not a member leaves the 401 or 441 to the nickname's shard
 void Server::handleKickCommand(int clientFd, const std::string &channelName, const std::string &target, const std::string &reason)
 {
     Client *client = getClient(clientFd);
     if (!client)
 	{
-        std::cerr << "Client " << clientFd << " not found" << std::endl;
+        LOG_WARN("Client " << clientFd << " not found");
         return;
     }
 
+    beginOp(clientFd);
+    SharedCard actor = cardOf(clientFd);
+    runOn(ownerOf(channelName), [actor, channelName, target, reason](Server &owner) {
+        if (owner.kickMember(actor, channelName, target, reason))
+        {
+            owner.finish(actor->ref);
+            return;
+        }
+        owner.runOn(owner.ownerOf(target), [actor, channelName, target](Server &nicks) {
+            nicks.replyNotOnChannel(actor, channelName, target);
+            nicks.finish(actor->ref);
+        });
+    });
+}
+
+// Returns false when the target is not in the channel, without replying
+bool Server::kickMember(const SharedCard &actor, const std::string &channelName, const std::string &target, const std::string &reason)
+{
+    int clientFd = actor->ref.fd;
     Channel *channel = getChannel(channelName);
     if (!channel)
 	{
-        std::cerr << "Channel " << channelName << " does not exist" << std::endl;
-        sendToClient(clientFd, "403 " + channelName + " :No such channel\r\n");
-        return;
+        LOG_WARN("Channel " << channelName << " does not exist");
+        sendReply(actor->ref, numeric(*actor, "403") << ' ' << channelName << " :No such channel");
+        return (true);
     }
 
-    if (!channel->isOperator(clientFd))
+    if (!channel->isOperator(actor->ref))
 	{
-        std::cerr << "Client " << clientFd << " does not have permission to kick users from channel " << channelName << std::endl;
-        sendToClient(clientFd, "482 " + channelName + " :You're not channel operator\r\n");
-        return;
+        LOG_WARN("Client " << clientFd << " does not have permission to kick users from channel " << channelName);
+        sendReply(actor->ref, numeric(*actor, "482") << ' ' << channelName << " :You're not channel operator");
+        return (true);
     }
 
-    Client *targetClient = getClientByNickname(target);
-    if (!targetClient)
-	{
-        std::cerr << "User " << target << " does not exist" << std::endl;
-        sendToClient(clientFd, "401 " + target + " :No such nick/channel\r\n");
-        return;
-    }
-
-    int targetFd = targetClient->getClientFd();
-    if (!channel->isMember(targetFd))
-	{
-        std::cerr << "User " << target << " is not in channel " << channelName << std::endl;
-        sendToClient(clientFd, "441 " + target + " " + channelName + " :They aren't on that channel\r\n");
-        return;
-    }
+    const ClientCard *member = channel->findMemberByNick(target);
+    if (!member)
+        return (false);
 
-    if (targetFd == clientFd)
+    ClientRef targetRef = member->ref;
+    std::string targetNickname = member->nickname;
+    if (targetRef == actor->ref)
 	{
-        std::cerr << "Client " << clientFd << " attempted to kick themselves from channel " << channelName << std::endl;
-        sendToClient(clientFd, "482 " + channelName + " :You cannot kick yourself\r\n");
-        return;
+        LOG_WARN("Client " << clientFd << " attempted to kick themselves from channel " << channelName);
+        sendReply(actor->ref, numeric(*actor, "482") << ' ' << channelName << " :You cannot kick yourself");
+        return (true);
     }
 
     std::string kickReason = reason.empty() ? "No reason given" : reason;
-    std::string kickMessage = ":" + client->getNickname() + " KICK " + channelName + " " + target + " :" + kickReason + "\r\n";
+    SharedMessage kickMessage = (Reply(actor->prefix, "KICK", channelName) << ' ' << target << " :" << kickReason).share();
 
-    for (int memberFd : channel->getMembers())
-    {
-		sendToClient(memberFd, kickMessage);
-	}
+    broadcastToChannel(*channel, kickMessage);
 
-	sendToClient(targetFd, "You have been kicked from " + channelName + " by " + client->getNickname() + " : " + kickReason + "\r\n");
-    channel->removeMember(targetFd);
-	targetClient->leaveChannel(channelName);
+	sendToClient(targetRef, std::make_shared<const std::string>("You have been kicked from " + channelName + " by " + actor->nickname + " : " + kickReason + "\r\n"));
+    channel->removeMember(targetRef);
+    std::string left = channel->getName();
+    runOn(targetRef.shard, [targetRef, left](Server &home) {
+        home.leftChannel(targetRef, left);
+    });
 
     if (channel->getMembers().empty())
 	{
-        channels.erase(channelName);
-        std::cout << "Channel " << channelName << " is now empty and has been removed" << std::endl;
+        LOG_INFO("Channel " << channel->getName() << " is now empty and has been removed");
+        channels.destroy(*channel);
     }
 
-    std::cout << "Client " << targetFd << " (" << targetClient->getNickname() << ") was kicked from channel " 
-              << channelName << " by " << client->getNickname() << " with reason: " << kickReason << std::endl;
+    LOG_INFO("Client " << targetRef.fd << " (" << targetNickname << ") was kicked from channel " 
+              << channelName << " by " << actor->nickname << " with reason: " << kickReason);
+    return (true);
 }
 
+void Server::replyNotOnChannel(const SharedCard &actor, const std::string &channelName, const std::string &target)
+{
+    ClientRef targetRef;
+    if (!findNickname(target, targetRef))
+	{
+        LOG_WARN("User " << target << " does not exist");
+        sendReply(actor->ref, numeric(*actor, "401") << ' ' << target << " :No such nick/channel");
+        return;
+    }
+
+    LOG_WARN("User " << target << " is not in channel " << channelName);
+    sendReply(actor->ref, numeric(*actor, "441") << ' ' << target << ' ' << channelName << " :They aren't on that channel");
+}
+
+// The nickname's shard checks the target exists, the channel's shard the inviter's rights, then the target's shard tells it
 void Server::handleInviteCommand(int clientFd, const std::string &channelName, const std::string &target)
 {
     Client *client = getClient(clientFd);
     if (!client)
 	{
-        std::cerr << "Client " << clientFd << " not found" << std::endl;
+        LOG_WARN("Inviting client not found");
         return;
     }
 
+    beginOp(clientFd);
+    SharedCard actor = cardOf(clientFd);
+    runOn(ownerOf(target), [actor, channelName, target](Server &nicks) {
+        ClientRef targetRef;
+        if (!nicks.findNickname(target, targetRef))
+        {
+            LOG_WARN("Target client " << target << " not found");
+            nicks.sendReply(actor->ref, nicks.numeric(*actor, "401") << ' ' << target << " :No such nick/channel");
+            nicks.finish(actor->ref);
+            return;
+        }
+        nicks.runOn(nicks.ownerOf(channelName), [actor, channelName, target, targetRef](Server &owner) {
+            owner.inviteMember(actor, channelName, target, targetRef);
+            owner.finish(actor->ref);
+        });
+    });
+}
+
+void Server::inviteMember(const SharedCard &actor, const std::string &channelName, const std::string &target, const ClientRef &targetRef)
+{
     Channel *channel = getChannel(channelName);
     if (!channel)
 	{
-        std::cerr << "Channel " << channelName << " does not exist" << std::endl;
-        sendToClient(clientFd, "403 " + channelName + " :No such channel\r\n");
+        LOG_WARN("Channel " << channelName << " does not exist");
+        sendReply(actor->ref, numeric(*actor, "403") << ' ' << channelName << " :No such channel");
         return;
     }
 
-    if (!channel->isOperator(clientFd))
+    if (!channel->isOperator(actor->ref))
 	{
-        std::cerr << "Client " << clientFd << " does not have permission to invite users to channel " << channelName << std::endl;
-        sendToClient(clientFd, "482 " + channelName + " :You're not channel operator\r\n");
+        LOG_WARN("Client " << actor->ref.fd << " is not an operator in channel " << channelName);
+        sendReply(actor->ref, numeric(*actor, "482") << ' ' << channelName << " :You're not channel operator");
         return;
     }
 
-    Client *targetClient = getClientByNickname(target);
-    if (!targetClient)
-	{
-        std::cerr << "User " << target << " does not exist" << std::endl;
-        sendToClient(clientFd, "401 " + target + " :No such nick/channel\r\n");
-        return;
-    }
-
-    int targetFd = targetClient->getClientFd();
-    channel->inviteUser(targetFd);
-
-    std::string inviteMessage = ":" + client->getNickname() + " INVITE " + target + " :" + channelName + "\r\n";
-    sendToClient(targetFd, inviteMessage);
+    channel->inviteUser(targetRef);
+    std::string invited = channel->getName();
+    SharedMessage message = (Reply(actor->prefix, "INVITE", target) << " :" << channelName).share();
+    runOn(targetRef.shard, [targetRef, invited, message](Server &home) {
+        home.invitedTo(targetRef, invited, message);
+    });
 
-    std::cout << "Client " << targetFd << " (" << targetClient->getNickname() << ") was invited to channel " 
-              << channelName << " by " << client->getNickname() << std::endl;
+    LOG_INFO("Client " << targetRef.fd << " (" << target << ") was invited to channel " 
+              << channelName << " by " << actor->nickname);
 }
 
 void Server::handleTopicCommand(int clientFd, const std::string &channelName, const std::string &topic)
@@ -160,164 +184,341 @@ void Server::handleTopicCommand(int clientFd, const std::string &channelName, co
     Client *client = getClient(clientFd);
     if (!client)
     {
-        std::cerr << "Client " << clientFd << " not found" << std::endl;
+        LOG_WARN("Client " << clientFd << " not found");
         return;
     }
 
+    beginOp(clientFd);
+    SharedCard actor = cardOf(clientFd);
+    runOn(ownerOf(channelName), [actor, channelName, topic](Server &owner) {
+        owner.changeTopic(actor, channelName, topic);
+        owner.finish(actor->ref);
+    });
+}
+
+void Server::changeTopic(const SharedCard &actor, const std::string &channelName, const std::string &topic)
+{
+    int clientFd = actor->ref.fd;
     Channel *channel = getChannel(channelName);
     if (!channel)
     {
-        std::cerr << "Channel " << channelName << " does not exist" << std::endl;
-        sendToClient(clientFd, "403 " + channelName + " :No such channel\r\n");
+        LOG_WARN("Channel " << channelName << " does not exist");
+        sendReply(actor->ref, numeric(*actor, "403") << ' ' << channelName << " :No such channel");
         return;
     }
 
-    if (channel->isTopicProtected() && !channel->isOperator(clientFd))
+    if (channel->isTopicProtected() && !channel->isOperator(actor->ref))
     {
-        std::cerr << "Client " << clientFd << " does not have permission to set or view the topic for channel " << channelName << std::endl;
-        sendToClient(clientFd, "482 " + channelName + " :You're not channel operator\r\n");
+        LOG_WARN("Client " << clientFd << " does not have permission to set or view the topic for channel " << channelName);
+        sendReply(actor->ref, numeric(*actor, "482") << ' ' << channelName << " :You're not channel operator");
         return;
     }
 
     if (!topic.empty())
     {
         channel->setTopic(topic);
-        std::string topicMessage = ":" + client->getNickname() + " TOPIC " + channelName + " :" + topic + "\r\n";
-
-        for (int memberFd : channel->getMembers())
-            sendToClient(memberFd, topicMessage);
+        broadcastToChannel(*channel, (Reply(actor->prefix, "TOPIC", channelName) << " :" << topic).share());
 
-        std::cout << "Client " << clientFd << " (" << client->getNickname() << ") set topic for channel "
-                  << channelName << " to: " << topic << std::endl;
+        LOG_INFO("Client " << clientFd << " (" << actor->nickname << ") set topic for channel "
+                  << channelName << " to: " << topic);
     }
     else
     {
         std::string currentTopic = channel->getTopic();
         if (!currentTopic.empty())
-            sendToClient(clientFd, "332 " + channelName + " :" + currentTopic + "\r\n");
+            sendReply(actor->ref, numeric(*actor, "332") << ' ' << channelName << " :" << currentTopic);
         else
-            sendToClient(clientFd, "331 " + channelName + " :No topic is set\r\n");
+            sendReply(actor->ref, numeric(*actor, "331") << ' ' << channelName << " :No topic is set");
     }
 }
 
-void Server::handleModeCommand(int clientFd, const std::string &channelName, char currentFlag, char modeChar, const std::string &parameter)
+// Applies one change, replying with its own numeric when it cannot be applied.
+// known holds the casemapped o/v targets that exist, asked from their shards beforehand
+bool Server::applyModeChange(const ClientCard &actor, Channel &channel, const ModeChange &change, const std::vector<std::string> &known)
+{
+    bool enable = (change.sign == '+');
+
+    if (change.mode == 'i') 
+        channel.setInviteOnly(enable);
+    else if (change.mode == 't') 
+        channel.setTopicProtected(enable);
+    else if (change.mode == 'k') 
+    {
+        if (enable) 
+            channel.setKey(change.parameter);
+        else 
+            channel.clearKey();
+    } 
+    else if (change.mode == 'l') 
+    {
+        if (!enable) 
+        {
+            channel.clearUserLimit();
+            return (true);
+        }
+        try 
+        {
+            int limit = std::stoi(change.parameter);
+            if (limit < 0) 
+            {
+                sendReply(actor.ref, numeric(actor, "461") << " MODE :Invalid parameter for +l");
+                return (false);
+            }
+            if (limit == 0)
+                channel.clearUserLimit();
+            else
+                channel.setUserLimit(limit);
+        } 
+        catch (const std::exception &e) 
+        {
+            sendReply(actor.ref, numeric(actor, "461") << " MODE :Invalid parameter for +l");
+            return (false);
+        }
+    } 
+    else if (change.mode == 'o' || change.mode == 'v') 
+    {
+        const ClientCard *member = channel.findMemberByNick(change.parameter);
+        if (!member && std::find(known.begin(), known.end(), ircLower(change.parameter)) == known.end())
+        {
+            sendReply(actor.ref, numeric(actor, "401") << ' ' << change.parameter << " :No such nick/channel");
+            return (false);
+        }
+        if (!member)
+        {
+            sendReply(actor.ref, numeric(actor, "441") << ' ' << change.parameter << ' ' << channel.getName() << " :They aren't on that channel");
+            return (false);
+        }
+
+        ClientRef targetRef = member->ref;
+        if (change.mode == 'o')
+            enable ? channel.addOperator(targetRef) : channel.removeOperator(targetRef);
+        else
+            enable ? channel.addVoice(targetRef) : channel.removeVoice(targetRef);
+    } 
+    else 
+    {
+        sendReply(actor.ref, numeric(actor, "472") << ' ' << change.mode << " :is unknown mode char to me for " << channel.getName());
+        return (false);
+    }
+    return (true);
+}
+
+// o and v need to know which targets exist at all; their shards are asked before the channel's shard applies the line
+void Server::handleModeCommand(int clientFd, const std::string &channelName, const std::vector<ModeChange> &changes)
 {
     Client *client = getClient(clientFd);
     if (!client) 
     {
-        sendToClient(clientFd, "401 :Client not found\r\n");
+        sendReply(clientFd, numeric(clientFd, "401") << " :Client not found");
         return;
     }
 
 	if (channelName.empty()) 
 	{
-		std::cerr << "Ignoring empty MODE command from client " << clientFd << std::endl;
+		LOG_WARN("Ignoring empty MODE command from client " << clientFd);
 		return;
 	}
 
 	if (client->getUsername() == channelName || client->getNickname() == channelName) 
     {
-        std::cerr << "Ignoring MODE command for client " << clientFd << std::endl;
+        LOG_WARN("Ignoring MODE command for client " << clientFd);
         return;
     }
 
+    beginOp(clientFd);
+    SharedCard actor = cardOf(clientFd);
+    std::vector<unsigned> shards;
+    std::vector<std::vector<std::string> > targets;
+    for (const ModeChange &change : changes)
+    {
+        if (change.mode != 'o' && change.mode != 'v')
+            continue;
+        unsigned shard = ownerOf(change.parameter);
+        size_t part = std::find(shards.begin(), shards.end(), shard) - shards.begin();
+        if (part == shards.size())
+        {
+            shards.push_back(shard);
+            targets.push_back(std::vector<std::string>());
+        }
+        targets[part].push_back(change.parameter);
+    }
+
+    gather<std::vector<std::string> >(shards, [targets](Server &nicks, size_t part) {
+        return (nicks.knownNicknames(targets[part]));
+    }, [actor, channelName, changes](Server &home, std::vector<std::vector<std::string> > &answers) {
+        std::vector<std::string> known;
+        for (const std::vector<std::string> &answer : answers)
+            known.insert(known.end(), answer.begin(), answer.end());
+        home.runOn(home.ownerOf(channelName), [actor, channelName, changes, known](Server &owner) {
+            owner.changeModes(actor, channelName, changes, known);
+            owner.finish(actor->ref);
+        });
+    });
+}
+
+void Server::changeModes(const SharedCard &actor, const std::string &channelName, const std::vector<ModeChange> &changes, const std::vector<std::string> &known)
+{
 	Channel *channel = getChannel(channelName);
     if (!channel) 
     {
-        sendToClient(clientFd, "403 " + channelName + " :No such channel\r\n");
+        sendReply(actor->ref, numeric(*actor, "403") << ' ' << channelName << " :No such channel");
         return;
     }
 
-    if (!channel->isOperator(clientFd)) 
+    if (!channel->isOperator(actor->ref)) 
     {
-        sendToClient(clientFd, "482 " + channelName + " :You're not channel operator\r\n");
+        sendReply(actor->ref, numeric(*actor, "482") << ' ' << channelName << " :You're not channel operator");
         return;
     }
 
-    if (modeChar == 'i') 
-    {
-        channel->setInviteOnly(currentFlag == '+');
-    } 
-    else if (modeChar == 't') 
-    {
-        channel->setTopicProtected(currentFlag == '+');
-    } 
-    else if (modeChar == 'k') 
+    // What applied goes out as "+ab-c p1 p2" lines, each carrying at most MAX_MODES parameters
+    std::string modes;
+    std::string parameters;
+    size_t parameterCount = 0;
+    char lastSign = '\0';
+    for (const ModeChange &change : changes)
     {
-        if (currentFlag == '+') 
+        if (!applyModeChange(*actor, *channel, change, known))
+            continue;
+        if (change.sign != lastSign)
         {
-            channel->setKey(parameter);
-        } 
-        else 
-        {
-            channel->clearKey();
+            modes += change.sign;
+            lastSign = change.sign;
         }
-    } 
-    else if (modeChar == 'l') 
-    {
-        if (currentFlag == '+') 
-        {
-            try 
-            {
-                int limit = std::stoi(parameter);
-                if (limit < 0) 
-                {
-                    sendToClient(clientFd, "461 MODE :Invalid parameter for +l\r\n");
-                    return;
-                }
-                if (limit == 0)
-                {
-                    channel->setUserLimit(MAX_CLIENTS);
-                }
-                else
-                    channel->setUserLimit(std::stoi(parameter));
-            } 
-            catch (const std::exception &e) 
-            {
-                sendToClient(clientFd, "461 MODE :Invalid parameter for +l\r\n");
-                return;
-            }
-        } 
-        else 
+        modes += change.mode;
+        if (!change.parameter.empty())
         {
-            channel->clearUserLimit();
+            parameters += " " + change.parameter;
+            parameterCount++;
         }
-    } 
-    else if (modeChar == 'o') 
-    {
-        Client *targetClient = getClientByNickname(parameter);
-        if (!targetClient) 
+        if (parameterCount == MAX_MODES)
         {
-            sendToClient(clientFd, "401 " + parameter + " :No such nick/channel\r\n");
-            return;
+            announceModes(*actor, *channel, modes, parameters);
+            modes.clear();
+            parameters.clear();
+            parameterCount = 0;
+            lastSign = '\0';
         }
+    }
+    announceModes(*actor, *channel, modes, parameters);
+}
 
-        int targetFd = targetClient->getClientFd();
-        if (currentFlag == '+') 
-        {
-            channel->addOperator(targetFd);
-        } 
-        else 
+void Server::announceModes(const ClientCard &actor, const Channel &channel, const std::string &modes, const std::string &parameters)
+{
+    if (modes.empty())
+        return;
+
+    broadcastToChannel(channel, (Reply(actor.prefix, "MODE", channel.getName()) << ' ' << modes << parameters).share());
+
+    LOG_INFO("Client " << actor.ref.fd << " set mode " << modes << parameters << " for channel " << channel.getName());
+}
+
+static bool memberBefore(const Membership &member, int clientFd)
+{
+    return (member.ref.fd < clientFd);
+}
+
+std::vector<Membership>::iterator Channel::findMember(const ClientRef &ref)
+{
+    auto it = std::lower_bound(members.begin(), members.end(), ref.fd, memberBefore);
+    if (it != members.end() && it->ref == ref)
+        return (it);
+    return (members.end());
+}
+
+std::vector<Membership>::const_iterator Channel::findMember(const ClientRef &ref) const
+{
+    auto it = std::lower_bound(members.begin(), members.end(), ref.fd, memberBefore);
+    if (it != members.end() && it->ref == ref)
+        return (it);
+    return (members.end());
+}
+
+// An entry on the same fd under another identity belongs to a closed connection whose leave is still on its way
+void Channel::addMember(const SharedCard &card, unsigned char flags)
+{
+    auto it = std::lower_bound(members.begin(), members.end(), card->ref.fd, memberBefore);
+    size_t index = it - members.begin();
+    Membership member = { card->ref, flags };
+    if (it != members.end() && it->ref.fd == card->ref.fd)
+    {
+        if (it->ref != card->ref)
         {
-            channel->removeOperator(targetFd);
+            *it = member;
+            cards[index] = card;
         }
-    } 
-    else 
-    {
-        sendToClient(clientFd, "501 :Unknown MODE flag\r\n");
         return;
     }
+    members.insert(it, member);
+    cards.insert(cards.begin() + index, card);
+}
 
-    std::string response = ":" + client->getNickname() + " MODE " + channelName + " " + currentFlag + modeChar + " " + parameter + "\r\n";
-    for (int memberFd : channel->getMembers()) 
+void Channel::removeMember(const ClientRef &ref)
+{
+    auto it = findMember(ref);
+    if (it == members.end())
+        return;
+    cards.erase(cards.begin() + (it - members.begin()));
+    members.erase(it);
+}
+
+const ClientCard *Channel::findMemberByNick(const std::string &nickname) const
+{
+    for (const SharedCard &card : cards)
     {
-        sendToClient(memberFd, response);
+        if (ircEquals(card->nickname, nickname))
+            return (card.get());
     }
+    return (NULL);
+}
 
-    std::cout << "Client " << clientFd << " set mode " << currentFlag << modeChar << " for channel " << channelName << std::endl;
+void Channel::updateCard(const SharedCard &card)
+{
+    auto it = findMember(card->ref);
+    if (it != members.end())
+        cards[it - members.begin()] = card;
+}
+
+bool Channel::isOperator(const ClientRef &ref) const
+{
+    auto it = findMember(ref);
+    return (it != members.end() && (it->flags & MEMBER_OP));
+}
+
+void Channel::setFlag(const ClientRef &ref, unsigned char flag, bool enabled)
+{
+    auto it = findMember(ref);
+    if (it == members.end())
+        return;
+    if (enabled)
+        it->flags |= flag;
+    else
+        it->flags &= ~flag;
+}
+
+static bool inviteBefore(const ClientRef &invited, int clientFd)
+{
+    return (invited.fd < clientFd);
+}
+
+void Channel::inviteUser(const ClientRef &ref)
+{
+    auto it = std::lower_bound(invitedUsers.begin(), invitedUsers.end(), ref.fd, inviteBefore);
+    if (it != invitedUsers.end() && it->fd == ref.fd)
+        *it = ref;
+    else
+        invitedUsers.insert(it, ref);
+}
+
+void Channel::uninviteUser(const ClientRef &ref)
+{
+    auto it = std::lower_bound(invitedUsers.begin(), invitedUsers.end(), ref.fd, inviteBefore);
+    if (it != invitedUsers.end() && *it == ref)
+        invitedUsers.erase(it);
 }
 
-void Channel::removeMember(int clientFd)
+bool Channel::isInvited(const ClientRef &ref) const
 {
-    members.erase(clientFd);
+    auto it = std::lower_bound(invitedUsers.begin(), invitedUsers.end(), ref.fd, inviteBefore);
+    return (it != invitedUsers.end() && *it == ref);
 }
@@ -0,0 +1,45 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ChannelRegistry.cpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 08:23:59 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 11:25:03 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ChannelRegistry.hpp"
+#include "Channel.hpp"
+
+ChannelRegistry::ChannelRegistry() {}
+
+ChannelRegistry::~ChannelRegistry() {}
+
+Channel *ChannelRegistry::find(const std::string &name) const
+{
+    auto it = channels.find(ircLower(name));
+    if (it != channels.end())
+        return (it->second.get());
+    return (nullptr);
+}
+
+Channel *ChannelRegistry::create(const std::string &name)
+{
+    auto slot = channels.emplace(ircLower(name), std::unique_ptr<Channel>());
+    if (slot.second)
+    {
+        slot.first->second.reset(new Channel(name));
+        slot.first->second->foldedName = &slot.first->first;
+    }
+    return (slot.first->second.get());
+}
+
+// Looked up first: erasing by the key itself would hand erase() a reference into the node it frees
+void ChannelRegistry::destroy(const Channel &channel)
+{
+    auto it = channels.find(channel.getFoldedName());
+    if (it != channels.end())
+        channels.erase(it);
+}
@@ -0,0 +1,42 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ChannelRegistry.hpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 08:23:59 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 11:25:03 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CHANNELREGISTRY_HPP
+# define CHANNELREGISTRY_HPP
+
+# include "Casemap.hpp"
+# include <memory>
+# include <string>
+# include <unordered_map>
+
+class Channel;
+
+// Channels are keyed by their casemapped name and heap-allocated once,
+// so a Channel pointer stays valid until the channel is destroyed. The key
+// is the only folded copy of a name; the Channel points at it.
+class ChannelRegistry
+{
+	private:
+		std::unordered_map<std::string, std::unique_ptr<Channel> >	channels;
+
+	public:
+		ChannelRegistry();
+		~ChannelRegistry();
+		ChannelRegistry(const ChannelRegistry &) = delete;
+		ChannelRegistry &operator=(const ChannelRegistry &) = delete;
+
+		Channel		*find(const std::string &name) const;
+		Channel		*create(const std::string &name);
+		void		destroy(const Channel &channel);
+};
+
+#endif
@@ -12,7 +12,11 @@
 
 #include "Client.hpp"
 
-Client::Client(int clientFd) : _clientFd(clientFd), _authenticated(false), _capNegotiation(false) {}
+Client::Client(int clientFd) : _clientFd(clientFd), _flags(0), _nickLength(0), _userLength(0), _capabilities(0), _profile(new ClientProfile())
+{
+    _nickname[0] = '\0';
+    _username[0] = '\0';
+}
 
 Client::~Client() {}
 
@@ -21,96 +25,81 @@ int Client::getClientFd() const {
 }
 
 void Client::setNickname(const std::string &nickname) {
-    _nickname = nickname;
-}
-
-std::string& Client::getReadBuffer() {
-    return _read_buffer;
-}
-
-void Client::setReadBuffer(const std::string &buf) {
-    _read_buffer = buf;
-}
-
-std::string& Client::getSendBuffer() {
-    return _send_buffer;
-}
-
-void Client::setSendBuffer(const std::string &buf) {
-    _send_buffer = buf;
-}
-
-const std::string& Client::getNickname() const { 
-    return _nickname;
+    _nickLength = std::min(nickname.size(), static_cast<size_t>(NICKLEN));
+    std::memcpy(_nickname, nickname.data(), _nickLength);
+    _nickname[_nickLength] = '\0';
+    _profile->prefix.clear();
+    _profile->card.reset();
 }
 
 void Client::setOldNickname(const std::string &nickname) {
-    _old_nickname = nickname;
+    _profile->oldNickname = nickname;
 }
 
 std::string& Client::getOldNickname() {
-    return _old_nickname;
+    return _profile->oldNickname;
 }
 
 void Client::setUsername(const std::string &username) {
-    _username = username;
-}
-
-std::string Client::getUsername() const {
-    return _username;
+    _userLength = std::min(username.size(), static_cast<size_t>(USERLEN));
+    std::memcpy(_username, username.data(), _userLength);
+    _username[_userLength] = '\0';
+    _profile->prefix.clear();
+    _profile->card.reset();
 }
 
 void Client::setRealname(const std::string &realname) {
-    _realname = realname;
+    _profile->realname = realname;
+    _profile->card.reset();
 }
 
 std::string Client::getRealname() const {
-    return _realname;
+    return _profile->realname;
+}
+
+void Client::setHostname(const std::string &host) {
+    _profile->host = host;
+    _profile->prefix.clear();
+    _profile->card.reset();
+}
+
+// Built on first use after NICK, USER or a host change, then reused by every message
+const std::string& Client::getPrefix() const {
+    if (_profile->prefix.empty())
+        _profile->prefix = getNickname() + "!" + getUsername() + "@" + _profile->host;
+    return _profile->prefix;
 }
 
 std::string& Client::getMode() {
-    return _mode;
+    return _profile->mode;
 }
 
 void Client::addMode(const std::string &mode) {
-    if (_mode.find(mode) == std::string::npos) {
-        _mode += mode;
+    if (_profile->mode.find(mode) == std::string::npos) {
+        _profile->mode += mode;
     }
 }
 
 void Client::removeMode(const std::string &mode) {
-    size_t pos = _mode.find(mode);
+    size_t pos = _profile->mode.find(mode);
     if (pos != std::string::npos) {
-        _mode.erase(pos, mode.length());
+        _profile->mode.erase(pos, mode.length());
     }
 }
 
-void Client::addCapability(const std::string &capability) {
-    if (std::find(_capabilities.begin(), _capabilities.end(), capability) == _capabilities.end()) {
-        _capabilities.push_back(capability);
-    }
-}
-
-bool Client::hasCapability(const std::string &capability) const {
-    return std::find(_capabilities.begin(), _capabilities.end(), capability) != _capabilities.end();
-}
-
-void Client::clearCapabilities() {
-    _capabilities.clear();
-}
-
-void Client::setAuthenticated(bool authenticated) {
-    _authenticated = authenticated;
+static unsigned capabilityBit(const std::string &capability) {
+    if (capability == "multi-prefix")
+        return CAP_MULTI_PREFIX;
+    if (capability == "sasl")
+        return CAP_SASL;
+    return 0;
 }
 
-bool Client::isAuthenticated() const {
-    return _authenticated;
+void Client::addCapability(const std::string &capability) {
+    _capabilities |= capabilityBit(capability);
 }
 
-void Client::setCapNegotiation(bool capNegotiation) {
-    _capNegotiation = capNegotiation;
+bool Client::hasCapability(const std::string &capability) const {
+    unsigned bit = capabilityBit(capability);
+    return bit && (_capabilities & bit);
 }
-
-bool Client::isCapNegotiating() const {
-    return _capNegotiation;
-}
\ No newline at end of file
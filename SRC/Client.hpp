@@ -31,24 +31,73 @@
 # include <algorithm>
 # include <set>
 
+# include <memory>
+# include "StringView.hpp"
+
+// Advertised in RPL_ISUPPORT; longer nicknames are refused, usernames are truncated
+# define NICKLEN	30
+# define USERLEN	10
+
+# define CLIENT_AUTHENTICATED	0x01
+# define CLIENT_OPERATOR		0x02
+# define CLIENT_CAP_NEGOTIATING	0x04
+# define CLIENT_WELCOME_SENT	0x08
+// Gone from its nick, channels and invites; only the ERROR line is left to write
+# define CLIENT_DETACHED		0x10
+
+# define CAP_MULTI_PREFIX	0x01
+# define CAP_SASL			0x02
+
+// Names a connection on any shard; the generation tells it apart from a later connection on the same fd
+struct ClientRef
+{
+    int         fd;
+    unsigned    generation;
+    unsigned    shard;
+
+    bool operator==(const ClientRef &other) const { return fd == other.fd && generation == other.generation && shard == other.shard; }
+    bool operator!=(const ClientRef &other) const { return !(*this == other); }
+};
+
+// What other shards know of a client: a snapshot taken after NICK or USER changed it, never modified
+struct ClientCard
+{
+    ClientRef   ref;
+    std::string nickname;
+    std::string username;
+    std::string realname;
+    std::string prefix;
+};
+
+typedef std::shared_ptr<const ClientCard> SharedCard;
+
+// Rarely touched state, kept out of the hot record
+struct ClientProfile
+{
+    std::string             realname;
+    std::string             host;
+    std::string             prefix;
+    std::string             oldNickname;
+    std::string             mode;
+    std::set<std::string>   joinedChannels;
+    std::set<std::string>   invitedChannels;
+    SharedCard              card;
+};
+
+// Everything fan-out and lookups read fits in one cache line
 class Client
 {
     private:
-        int				            _clientFd;
-        std::string		            _read_buffer;
-        std::string		            _send_buffer;
-        std::string		            _nickname;
-        std::string		            _old_nickname;
-        std::string		            _username;
-        std::string		            _realname;
-        std::string		            _mode;
-        std::vector<std::string>    _capabilities;
-        bool                        _authenticated;
-        bool                        _operator;
-        bool                        _capNegotiation; 
-		bool			            _welcomeSent;
-		
-        std::set<std::string> joinedChannels;
+        int                             _clientFd;
+        unsigned char                   _flags;
+        unsigned char                   _nickLength;
+        unsigned char                   _userLength;
+        unsigned                        _capabilities;
+        char                            _nickname[NICKLEN + 1];
+        char                            _username[USERLEN + 1];
+        std::unique_ptr<ClientProfile>  _profile;
+
+        void    setFlag(unsigned char flag, bool enabled) { _flags = enabled ? (_flags | flag) : (_flags & ~flag); }
 
     public:
         Client(int clientFd);
@@ -56,40 +105,50 @@ class Client
         
         int				    getClientFd()const;
         void			    setNickname(std::string const &nickname);
-        std::string&	    getReadBuffer();
-        void			    setReadBuffer(std::string const &buf);
-        std::string&	    getSendBuffer();
-        void			    setSendBuffer(std::string const &buf);
 
-        const std::string&  getNickname() const; 
+        std::string         getNickname() const { return std::string(_nickname, _nickLength); }
+        StringView          getNicknameView() const { return StringView(_nickname, _nickLength); }
         void			    setOldNickname(std::string const &nickname);
         std::string&	    getOldNickname();
         void			    setUsername(std::string const &username);
-        std::string		    getUsername()const;
+        std::string		    getUsername() const { return std::string(_username, _userLength); }
         void			    setRealname(std::string const &realname);
         std::string		    getRealname()const;
+        void                setHostname(std::string const &host);
+        const std::string&  getPrefix() const;
 
-        bool                isOperator() {return _operator;}
+        bool                isOperator() const { return _flags & CLIENT_OPERATOR; }
         std::string&	    getMode();
         void			    addMode(const std::string &mode);
         void			    removeMode(const std::string &mode);
 
         void addCapability(const std::string &capability);
         bool hasCapability(const std::string &capability) const;
-        void clearCapabilities();
+        bool hasCapability(unsigned capability) const { return _capabilities & capability; }
+        void clearCapabilities() { _capabilities = 0; }
+
+        void setAuthenticated(bool authenticated) { setFlag(CLIENT_AUTHENTICATED, authenticated); }
+        bool isAuthenticated() const { return _flags & CLIENT_AUTHENTICATED; }
+
+        void setCapNegotiation(bool capNegotiation) { setFlag(CLIENT_CAP_NEGOTIATING, capNegotiation); }
+        bool isCapNegotiating() const { return _flags & CLIENT_CAP_NEGOTIATING; }
+
+		void setWelcomeSent(bool welcomeSent) { setFlag(CLIENT_WELCOME_SENT, welcomeSent); }
+		bool isWelcomeSent() const { return _flags & CLIENT_WELCOME_SENT; }
 
-        void setAuthenticated(bool authenticated); 
-        bool isAuthenticated() const;
+        void setDetached(bool detached) { setFlag(CLIENT_DETACHED, detached); }
+        bool isDetached() const { return _flags & CLIENT_DETACHED; }
 
-        void setCapNegotiation(bool capNegotiation);
-        bool isCapNegotiating() const; 
+        const SharedCard &getCard() const { return _profile->card; }
+        void setCard(const SharedCard &card) { _profile->card = card; }
 
-		void setWelcomeSent(bool welcomeSent) { _welcomeSent = welcomeSent; }
-		bool isWelcomeSent() const { return _welcomeSent; }
+        void joinChannel(const std::string &channelName) { _profile->joinedChannels.insert(channelName); }
+        void leaveChannel(const std::string &channelName) { _profile->joinedChannels.erase(channelName); }
+        const std::set<std::string> &getJoinedChannels() const { return _profile->joinedChannels; }
+        std::set<std::string> &getJoinedChannels() { return _profile->joinedChannels; }
 
-        void joinChannel(const std::string &channelName) { joinedChannels.insert(channelName); }
-        void leaveChannel(const std::string &channelName) { joinedChannels.erase(channelName); }
-        const std::set<std::string> &getJoinedChannels() const { return joinedChannels; }
+        void addInvite(const std::string &channelName) { _profile->invitedChannels.insert(channelName); }
+        std::set<std::string> &getInvitedChannels() { return _profile->invitedChannels; }
 };
 
-#endif
\ No newline at end of file
+#endif
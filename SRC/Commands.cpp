@@ -11,143 +11,141 @@
 /* ************************************************************************** */
 
 #include "Commands.hpp"
+#include <cctype>
 
 void nick(Server *server, int clientFd, const cmd_syntax &parsed) {
     if (parsed.params.empty()) {
-        std::cerr << "No nickname provided" << std::endl;
+        LOG_WARN("No nickname provided");
         return;
     }
 
-    std::string nickname = parsed.params[0];
+    std::string nickname = parsed.params[0].str();
     server->handleNickCommand(clientFd, nickname);
 }
 
 void cap(Server *server, int clientFd, const cmd_syntax &parsed) {
     if (parsed.params.empty()) {
-        std::cerr << "No CAP command provided" << std::endl;
+        LOG_WARN("No CAP command provided");
         return;
     }
 
-    std::string subcommand = parsed.params[0];
+    std::string subcommand = parsed.params[0].str();
     if (subcommand == "LS") {
-        std::string capList = "multi-prefix sasl";
-        std::string response = "CAP * LS :" + capList + "\r\n";
-        server->sendToClient(clientFd, response);
+        server->sendReply(clientFd, Reply(server->getHostname(), "CAP", "*") << " LS :multi-prefix sasl");
     } else if (subcommand == "REQ") {
         if (parsed.message.empty()) {
-            std::cerr << "No capabilities requested" << std::endl;
+            LOG_WARN("No capabilities requested");
             return;
         }
 
-        std::string response = "CAP * ACK :" + parsed.message + "\r\n";
-        server->sendToClient(clientFd, response);
+        Client *client = server->getClient(clientFd);
+        std::istringstream requested(parsed.message.str());
+        std::string capability;
+        while (client && requested >> capability)
+            client->addCapability(capability);
+
+        server->sendReply(clientFd, Reply(server->getHostname(), "CAP", "*") << " ACK :" << parsed.message);
     } else if (subcommand == "END") {
 		Client *client = server->getClient(clientFd);
 		if (!client) {
-			std::cerr << "Client " << clientFd << " not found" << std::endl;
+			LOG_WARN("Client " << clientFd << " not found");
 			return;
 		}
 		client->setCapNegotiation(false);
 
-        std::cout << "CAP negotiation ended for client " << clientFd << std::endl;
+        LOG_INFO("CAP negotiation ended for client " << clientFd);
     } else {
-        std::cerr << "Unknown CAP subcommand: " << subcommand << std::endl;
-        std::string response = "CAP * NAK :" + subcommand + "\r\n";
-        server->sendToClient(clientFd, response);
+        LOG_WARN("Unknown CAP subcommand: " << subcommand);
+        server->sendReply(clientFd, Reply(server->getHostname(), "CAP", "*") << " NAK :" << subcommand);
     }
 }
 
 void join(Server *server, int clientFd, const cmd_syntax &parsed) {
     Client *client = server->getClient(clientFd);
     if (!client) {
-        std::cerr << "Client " << clientFd << " not found" << std::endl;
+        LOG_WARN("Client " << clientFd << " not found");
         return;
     }
 
     if (client->isCapNegotiating()) {
-        std::cerr << "Client " << clientFd << " attempted to JOIN during CAP negotiation" << std::endl;
+        LOG_WARN("Client " << clientFd << " attempted to JOIN during CAP negotiation");
 
         if (parsed.params.empty() || parsed.params[0].empty()) {
-            std::cout << "Ignoring empty JOIN command from client " << clientFd << " during CAP negotiation" << std::endl;
+            LOG_INFO("Ignoring empty JOIN command from client " << clientFd << " during CAP negotiation");
             return;
         }
 
-        std::string response = "451 JOIN :You cannot join a channel during CAP negotiation\r\n";
-        server->sendToClient(clientFd, response);
+        server->sendReply(clientFd, server->numeric(clientFd, "451") << " JOIN :You cannot join a channel during CAP negotiation");
         return;
     }
 
     if (parsed.params.empty() || parsed.params[0].empty()) {
-        std::cerr << "No channel provided for JOIN command from client " << clientFd << std::endl;
-        std::string response = "461 JOIN :Not enough parameters\r\n";
-        server->sendToClient(clientFd, response);
+        LOG_WARN("No channel provided for JOIN command from client " << clientFd);
+        server->sendReply(clientFd, server->numeric(clientFd, "461") << " JOIN :Not enough parameters");
         return;
     }
 
-    std::string channel = parsed.params[0];
-    std::string providedKey = parsed.params.size() > 1 ? parsed.params[1] : "";
-    std::cout << "Handling JOIN command for client " << clientFd << " with channel " << channel << std::endl;
+    std::string channel = parsed.params[0].str();
+    std::string providedKey = parsed.params.size() > 1 ? parsed.params[1].str() : "";
+    LOG_INFO("Handling JOIN command for client " << clientFd << " with channel " << channel);
     server->handleJoinCommand(clientFd, channel, providedKey);
 }
 
 void user(Server *server, int clientFd, const cmd_syntax &parsed) {
     if (parsed.params.size() < 3 || parsed.message.empty()) {
-        std::cerr << "Not enough parameters for USER command" << std::endl;
-        std::string response = "461 USER :Not enough parameters\r\n"; 
-        server->sendToClient(clientFd, response);
+        LOG_WARN("Not enough parameters for USER command");
+        server->sendReply(clientFd, server->numeric(clientFd, "461") << " USER :Not enough parameters");
         return;
     }
 
-    std::string username = parsed.params[0];
-    std::string hostname = parsed.params[1];
-    std::string servername = parsed.params[2];
-    std::string realname = parsed.message;
+    std::string username = parsed.params[0].str();
+    std::string hostname = parsed.params[1].str();
+    std::string servername = parsed.params[2].str();
+    std::string realname = parsed.message.str();
 
     server->handleUserCommand(clientFd, username, hostname, servername, realname);
 }
 
 void pass(Server *server, int clientFd, const cmd_syntax &parsed) {
     if (parsed.params.empty()) {
-        std::cerr << "No password provided" << std::endl;
+        LOG_WARN("No password provided");
         return;
     }
 
-    std::string password = parsed.params[0];
+    std::string password = parsed.params[0].str();
     server->handlePassCommand(clientFd, password);
 }
 
 void ping(Server *server, int clientFd, const cmd_syntax &parsed) {
-    if (parsed.params.empty()) {
-        std::cerr << "No PING parameters provided" << std::endl;
+    if (parsed.params.empty() && parsed.message.empty()) {
+        LOG_WARN("No PING parameters provided");
         return;
     }
 
-    std::string response = "PONG :" + parsed.params[0] + "\r\n";
-    server->sendToClient(clientFd, response);
+    StringView token = parsed.params.empty() ? parsed.message : parsed.params[0];
+    server->sendReply(clientFd, Reply(server->getHostname(), "PONG", server->getHostname()) << " :" << token);
 }
 
 void part(Server *server, int clientFd, const cmd_syntax &parsed) {
     if (parsed.params.empty()) {
-        std::cerr << "No channel provided for PART command" << std::endl;
-        std::string response = "461 PART :Not enough parameters\r\n"; 
-        server->sendToClient(clientFd, response);
+        LOG_WARN("No channel provided for PART command");
+        server->sendReply(clientFd, server->numeric(clientFd, "461") << " PART :Not enough parameters");
         return;
     }
 
-    std::string channel = parsed.params[0];
+    std::string channel = parsed.params[0].str();
     server->handlePartCommand(clientFd, channel, parsed);
 }
 
 void privmsg(Server *server, int clientFd, const cmd_syntax &parsed) {
     if (parsed.params.empty() || parsed.message.empty()) {
-        std::cerr << "No target or message provided for PRIVMSG command" << std::endl;
-        std::string response = "461 PRIVMSG :Not enough parameters\r\n"; 
-        server->sendToClient(clientFd, response);
+        LOG_WARN("No target or message provided for PRIVMSG command");
+        server->sendReply(clientFd, server->numeric(clientFd, "461") << " PRIVMSG :Not enough parameters");
         return;
     }
 
-    std::string target = parsed.params[0];
-    std::string message = parsed.message;
+    std::string target = parsed.params[0].str();
+    std::string message = parsed.message.str();
 
     server->handlePrivmsgCommand(clientFd, target, message);
 }
@@ -158,13 +156,13 @@ void help(Server *server, int clientFd, const cmd_syntax &parsed) {
 }
 
 void who(Server *server, int clientFd, const cmd_syntax &parsed) {
-    std::string target = parsed.params.empty() ? "" : parsed.params[0];
+    std::string target = parsed.params.empty() ? "" : parsed.params[0].str();
 
     server->handleWhoCommand(clientFd, target);
 }
 
 void quit(Server *server, int clientFd, const cmd_syntax &parsed) {
-    std::string quitMessage = parsed.message.empty() ? "Client disconnected" : parsed.message;
+    std::string quitMessage = parsed.message.empty() ? "Client disconnected" : parsed.message.str();
 
     server->handleQuitCommand(clientFd, quitMessage);
 }
@@ -172,13 +170,13 @@ void quit(Server *server, int clientFd, const cmd_syntax &parsed) {
 void kick(Server *server, int clientFd, const cmd_syntax &parsed) 
 {
 	if (parsed.params.size() < 2) {
-		std::cerr << "Not enough parameters for KICK command" << std::endl;
+		LOG_WARN("Not enough parameters for KICK command");
 		return;
 	}
 
-	std::string channel = parsed.params[0];
-	std::string targetNick = parsed.params[1];
-	std::string reason = parsed.message.empty() ? "No reason provided" : parsed.message;
+	std::string channel = parsed.params[0].str();
+	std::string targetNick = parsed.params[1].str();
+	std::string reason = parsed.message.empty() ? "No reason provided" : parsed.message.str();
 
 	server->handleKickCommand(clientFd, channel, targetNick, reason);
 }
@@ -186,65 +184,26 @@ void kick(Server *server, int clientFd, const cmd_syntax &parsed)
 void invite(Server *server, int clientFd, const cmd_syntax &parsed) 
 {
     if (parsed.params.size() < 2) {
-        std::cerr << "Not enough parameters for INVITE command" << std::endl;
-        std::string response = "461 INVITE :Not enough parameters\r\n"; 
-        server->sendToClient(clientFd, response);
-        return;
-    }
-
-    std::string channelName = parsed.params[0];
-    std::string targetNick = parsed.params[1];
-
-    Client *client = server->getClient(clientFd);
-    if (!client) {
-        std::cerr << "Inviting client not found" << std::endl;
-        return;
-    }
-
-    Client *targetClient = server->getClientByNickname(targetNick);
-    if (!targetClient) {
-        std::cerr << "Target client " << targetNick << " not found" << std::endl;
-        std::string response = "401 " + targetNick + " :No such nick/channel\r\n";
-        server->sendToClient(clientFd, response);
-        return;
-    }
-
-    Channel *channel = server->getChannel(channelName);
-    if (!channel) {
-        std::cerr << "Channel " << channelName << " does not exist" << std::endl;
-        std::string response = "403 " + channelName + " :No such channel\r\n"; 
-        server->sendToClient(clientFd, response);
-        return;
-    }
-
-    if (!channel->isOperator(clientFd)) {
-        std::cerr << "Client " << clientFd << " is not an operator in channel " << channelName << std::endl;
-        std::string response = "482 " + channelName + " :You're not channel operator\r\n"; 
-        server->sendToClient(clientFd, response);
+        LOG_WARN("Not enough parameters for INVITE command");
+        server->sendReply(clientFd, server->numeric(clientFd, "461") << " INVITE :Not enough parameters");
         return;
     }
 
-    int targetFd = targetClient->getClientFd();
-    channel->inviteUser(targetFd);
-
-    std::string inviteMessage = ":" + client->getNickname() + "!" + 
-        client->getUsername() + "@" + server->getHostname() + " INVITE " + 
-        targetNick + " :" + channelName + "\r\n";
-    server->sendToClient(targetFd, inviteMessage);
+    std::string channelName = parsed.params[0].str();
+    std::string targetNick = parsed.params[1].str();
 
-    std::cout << "Client " << targetFd << " (" << targetClient->getNickname() << ") was invited to channel " 
-              << channelName << " by " << client->getNickname() << std::endl;
+    server->handleInviteCommand(clientFd, channelName, targetNick);
 }
 
 void topic(Server *server, int clientFd, const cmd_syntax &parsed) 
 {
 	if (parsed.params.empty()) {
-		std::cerr << "No channel provided for TOPIC command" << std::endl;
+		LOG_WARN("No channel provided for TOPIC command");
 		return;
 	}
 
-	std::string channel = parsed.params[0];
-	std::string topic = parsed.message;
+	std::string channel = parsed.params[0].str();
+	std::string topic = parsed.message.str();
 
 	server->handleTopicCommand(clientFd, channel, topic);
 }
@@ -253,50 +212,170 @@ void mode(Server *server, int clientFd, const cmd_syntax &parsed)
 {
     if (parsed.params.size() < 2) 
     {
-        std::cerr << "Not enough parameters for MODE command" << std::endl;
-        std::string response = "461 MODE :Not enough parameters\r\n"; 
-        server->sendToClient(clientFd, response);
+        LOG_WARN("Not enough parameters for MODE command");
+        server->sendReply(clientFd, server->numeric(clientFd, "461") << " MODE :Not enough parameters");
         return;
     }
 
-    std::string channelName = parsed.params[0];
-    std::string modeString = parsed.params[1];
+    std::string channelName = parsed.params[0].str();
+    std::string modeString = parsed.params[1].str();
     size_t paramIndex = 2;
-    char currentFlag = '\0';
+    char currentFlag = '+';
+    std::vector<ModeChange> changes;
 
+    // Collect the whole line first so the server applies and announces it in batches of MODES=MAX_MODES
     for (char modeChar : modeString) 
     {
         if (modeChar == '+' || modeChar == '-') 
         {
             currentFlag = modeChar;
-        } 
-        else 
+            continue;
+        }
+        if (!std::strchr(CHANNEL_MODES, modeChar))
         {
-            std::string parameter;
+            server->sendReply(clientFd, server->numeric(clientFd, "472") << ' ' << modeChar << " :is unknown mode char to me for " << channelName);
+            continue;
+        }
 
-            if ((modeChar == 'k' || modeChar == 'o' || (modeChar == 'l' && currentFlag == '+')) && paramIndex < parsed.params.size()) 
-            {
-                parameter = parsed.params[paramIndex];
-                paramIndex++;
-            } 
-            else if (modeChar == 'k' || modeChar == 'o' || (modeChar == 'l' && currentFlag == '+')) 
-            {
-                std::cerr << "Not enough parameters for MODE command" << std::endl;
-                std::string response = "461 MODE :Not enough parameters\r\n"; 
-                server->sendToClient(clientFd, response);
-                return;
-            } 
-            else if (modeChar == 'l' && currentFlag == '-') 
+        ModeChange change = { currentFlag, modeChar, std::string() };
+        if (modeChar == 'k' || modeChar == 'o' || modeChar == 'v' || (modeChar == 'l' && currentFlag == '+')) 
+        {
+            if (paramIndex >= parsed.params.size())
             {
-                parameter = "";
+                LOG_WARN("Not enough parameters for MODE " << currentFlag << modeChar);
+                server->sendReply(clientFd, server->numeric(clientFd, "461") << " MODE :Not enough parameters for " << currentFlag << modeChar);
+                continue;
             }
-
-            server->handleModeCommand(clientFd, channelName, currentFlag, modeChar, parameter);
+            change.parameter = parsed.params[paramIndex++].str();
         }
+        changes.push_back(change);
     }
 
     if (paramIndex < parsed.params.size()) 
     {
-        std::cerr << "Extra parameters provided for MODE command" << std::endl;
+        LOG_WARN("Extra parameters provided for MODE command");
+    }
+
+    if (!changes.empty())
+        server->handleModeCommand(clientFd, channelName, changes);
+}
+
+// Commands whose every reply comes from the shard owning the channel or nick they name.
+// Anything that answers from the client's own shard first, or visits more than one shard, runs alone
+static unsigned routeJoin(Server *server, int clientFd, const cmd_syntax &parsed)
+{
+    Client *client = server->getClient(clientFd);
+    if (!client || client->isCapNegotiating() || parsed.params.empty() || parsed.params[0].empty())
+        return ROUTE_ALONE;
+    return server->ownerOf(parsed.params[0]);
+}
+
+static unsigned routeTarget(Server *server, int clientFd, const cmd_syntax &parsed)
+{
+    (void)clientFd;
+    if (parsed.params.empty())
+        return ROUTE_ALONE;
+    return server->ownerOf(parsed.params[0]);
+}
+
+static unsigned routePrivmsg(Server *server, int clientFd, const cmd_syntax &parsed)
+{
+    if (parsed.message.empty())
+        return ROUTE_ALONE;
+    return routeTarget(server, clientFd, parsed);
+}
+
+static unsigned routeWho(Server *server, int clientFd, const cmd_syntax &parsed)
+{
+    if (parsed.params.empty() || parsed.params[0].empty() || parsed.params[0][0] != '#')
+        return ROUTE_ALONE;
+    return routeTarget(server, clientFd, parsed);
+}
+
+// Adding a command means adding a row here, lookup is case-insensitive
+static CommandSpec commandTable[] = {
+    // cost is the flood credit a command spends, in lines; commands that fan out or list more cost more.
+    // NICK is free until the client is registered, see handleIncomingMessage
+    // name       handler   minParams  registered  cost  route         calls
+    { "CAP",      cap,      1,         false,      0,    NULL,         {0} },
+    { "PASS",     pass,     1,         false,      0,    NULL,         {0} },
+    { "NICK",     nick,     1,         false,      1,    NULL,         {0} },
+    { "USER",     user,     4,         false,      0,    NULL,         {0} },
+    { "PING",     ping,     1,         false,      0,    NULL,         {0} },
+    { "QUIT",     quit,     0,         false,      0,    NULL,         {0} },
+    { "INFO",     help,     0,         false,      2,    NULL,         {0} },
+    { "JOIN",     join,     1,         true,       2,    routeJoin,    {0} },
+    { "PART",     part,     1,         true,       1,    routeTarget,  {0} },
+    { "PRIVMSG",  privmsg,  2,         true,       1,    routePrivmsg, {0} },
+    { "WHO",      who,      0,         true,       2,    routeWho,     {0} },
+    { "KICK",     kick,     2,         true,       1,    NULL,         {0} },
+    { "INVITE",   invite,   2,         true,       2,    NULL,         {0} },
+    { "TOPIC",    topic,    1,         true,       1,    routeTarget,  {0} },
+    { "MODE",     mode,     1,         true,       1,    NULL,         {0} },
+};
+
+#define COMMAND_COUNT (sizeof(commandTable) / sizeof(commandTable[0]))
+#define COMMAND_SLOTS 64
+
+static unsigned int hashCommand(const char *name, size_t length)
+{
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ static_cast<unsigned char>(std::toupper(static_cast<unsigned char>(name[i])))) * 16777619u;
+    return hash;
+}
+
+static bool sameCommand(const char *name, const StringView &candidate)
+{
+    size_t i = 0;
+    for (; i < candidate.size(); i++)
+    {
+        if (!name[i] || name[i] != std::toupper(static_cast<unsigned char>(candidate[i])))
+            return false;
+    }
+    return name[i] == '\0';
+}
+
+// Open addressing over the table rows
+static CommandSpec **buildCommandSlots()
+{
+    static CommandSpec *slots[COMMAND_SLOTS] = {};
+
+    for (size_t i = 0; i < COMMAND_COUNT; i++)
+    {
+        unsigned int slot = hashCommand(commandTable[i].name, std::strlen(commandTable[i].name)) % COMMAND_SLOTS;
+        while (slots[slot])
+            slot = (slot + 1) % COMMAND_SLOTS;
+        slots[slot] = &commandTable[i];
+    }
+    return slots;
+}
+
+// Built once, by whichever shard looks a command up first
+static CommandSpec **commandSlots()
+{
+    static CommandSpec **slots = buildCommandSlots();
+    return slots;
+}
+
+CommandSpec *findCommand(const StringView &name)
+{
+    CommandSpec **slots = commandSlots();
+    unsigned int slot = hashCommand(name.data(), name.size()) % COMMAND_SLOTS;
+
+    while (slots[slot])
+    {
+        if (sameCommand(slots[slot]->name, name))
+            return slots[slot];
+        slot = (slot + 1) % COMMAND_SLOTS;
     }
+    return NULL;
+}
+
+void logCommandStats()
+{
+    std::string usage = "Command usage:";
+    for (size_t i = 0; i < COMMAND_COUNT; i++)
+        usage += " " + std::string(commandTable[i].name) + "=" + std::to_string(commandTable[i].calls.load(std::memory_order_relaxed));
+    LOG_INFO(usage);
 }
@@ -16,6 +16,7 @@
 # include "Server.hpp"
 # include "Client.hpp"
 # include "Parsing.hpp"
+# include <atomic>
 
 void nick(Server *server, int clientFd, const cmd_syntax &parsed);
 void cap(Server *server, int clientFd, const cmd_syntax &parsed);
@@ -33,4 +34,22 @@ void invite(Server *server, int clientFd, const cmd_syntax &parsed);
 void topic(Server *server, int clientFd, const cmd_syntax &parsed);
 void mode(Server *server, int clientFd, const cmd_syntax &parsed);
 
+typedef void (*CommandHandler)(Server *server, int clientFd, const cmd_syntax &parsed);
+// The shard a command's whole reply comes from, or ROUTE_ALONE, see Server::handleIncomingMessage
+typedef unsigned (*CommandRoute)(Server *server, int clientFd, const cmd_syntax &parsed);
+
+struct CommandSpec
+{
+	const char					*name;
+	CommandHandler				handler;
+	size_t						minParams;
+	bool						requiresRegistration;
+	unsigned					cost;
+	CommandRoute				route;
+	std::atomic<unsigned long>	calls;
+};
+
+CommandSpec	*findCommand(const StringView &name);
+void		logCommandStats();
+
 #endif
\ No newline at end of file
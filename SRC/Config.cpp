@@ -0,0 +1,68 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Config.cpp                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 07:06:12 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 09:43:02 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Config.hpp"
+#include <cstdlib>
+#include <iostream>
+
+static std::string envString(const char *name, const std::string &fallback)
+{
+    const char *value = std::getenv(name);
+    if (!value || !*value)
+        return (fallback);
+    return (std::string(value));
+}
+
+static long envNumber(const char *name, long fallback, long min, long max)
+{
+    const char *value = std::getenv(name);
+    if (!value || !*value)
+        return (fallback);
+
+    char *end;
+    long number = std::strtol(value, &end, 10);
+    if (*end != '\0' || number < min || number > max)
+    {
+        std::cerr << "Ignoring invalid " << name << "=" << value << " (expected " << min << "-" << max << ")" << std::endl;
+        return (fallback);
+    }
+    return (number);
+}
+
+ServerConfig::ServerConfig() : backend("epoll"), shards(1), maxClients(1000), sendqSoft(256 * 1024), sendqHard(1024 * 1024), sendqGrace(30), listenBacklog(0), acceptBatch(64), statsInterval(60), floodBurst(10), floodRate(2), recvqMax(8192), tickLines(32), logLevel("info") {}
+
+ServerConfig ServerConfig::fromEnvironment()
+{
+    ServerConfig config;
+
+    config.backend = envString("IRCSERV_BACKEND", config.backend);
+    config.logLevel = envString("IRCSERV_LOG_LEVEL", config.logLevel);
+    config.logFile = envString("IRCSERV_LOG_FILE", config.logFile);
+    config.shards = envNumber("IRCSERV_SHARDS", config.shards, 1, 64);
+    config.maxClients = envNumber("IRCSERV_MAX_CLIENTS", config.maxClients, 1, 1000000);
+    config.sendqSoft = envNumber("IRCSERV_SENDQ_SOFT", config.sendqSoft, 4096, 1L << 30);
+    config.sendqHard = envNumber("IRCSERV_SENDQ_HARD", config.sendqHard, 4096, 1L << 30);
+    config.sendqGrace = envNumber("IRCSERV_SENDQ_GRACE", config.sendqGrace, 0, 3600);
+    config.listenBacklog = envNumber("IRCSERV_LISTEN_BACKLOG", config.listenBacklog, 0, 65535);
+    config.acceptBatch = envNumber("IRCSERV_ACCEPT_BATCH", config.acceptBatch, 1, 65536);
+    config.statsInterval = envNumber("IRCSERV_STATS_INTERVAL", config.statsInterval, 0, 86400);
+    config.floodBurst = envNumber("IRCSERV_FLOOD_BURST", config.floodBurst, 1, 100000);
+    config.floodRate = envNumber("IRCSERV_FLOOD_RATE", config.floodRate, 0, 100000);
+    config.recvqMax = envNumber("IRCSERV_RECVQ", config.recvqMax, 512, 1L << 30);
+    config.tickLines = envNumber("IRCSERV_TICK_LINES", config.tickLines, 1, 1000000);
+    if (config.sendqSoft > config.sendqHard)
+    {
+        std::cerr << "IRCSERV_SENDQ_SOFT is above IRCSERV_SENDQ_HARD, using " << config.sendqHard << " for both" << std::endl;
+        config.sendqSoft = config.sendqHard;
+    }
+    return (config);
+}
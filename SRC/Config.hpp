@@ -0,0 +1,41 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Config.hpp                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 07:06:12 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 09:43:02 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CONFIG_HPP
+# define CONFIG_HPP
+
+# include <string>
+# include <cstddef>
+
+struct ServerConfig
+{
+	std::string	backend;
+	size_t		shards;
+	size_t		maxClients;
+	size_t		sendqSoft;
+	size_t		sendqHard;
+	long		sendqGrace;
+	int			listenBacklog;
+	size_t		acceptBatch;
+	long		statsInterval;
+	long		floodBurst;
+	long		floodRate;
+	size_t		recvqMax;
+	size_t		tickLines;
+	std::string	logLevel;
+	std::string	logFile;
+
+	ServerConfig();
+	static ServerConfig fromEnvironment();
+};
+
+#endif
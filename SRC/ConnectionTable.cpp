@@ -0,0 +1,107 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ConnectionTable.cpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 08:08:31 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 08:58:51 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "ConnectionTable.hpp"
+#include <new>
+
+ConnectionPool::ConnectionPool(size_t capacity)
+{
+    reserve(capacity);
+}
+
+void ConnectionPool::reserve(size_t capacity)
+{
+    while (this->capacity() < capacity)
+        grow();
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    reclaim();
+}
+
+void ConnectionPool::grow()
+{
+    slabs.push_back(std::unique_ptr<Storage[]>(new Storage[CONNECTION_SLAB]));
+    Storage *slab = slabs.back().get();
+    // Handed out lowest address first, so a fresh slab is filled front to back
+    for (size_t i = CONNECTION_SLAB; i > 0; i--)
+        freeList.push_back(&slab[i - 1]);
+}
+
+Connection *ConnectionPool::acquire(int clientFd)
+{
+    if (freeList.empty())
+        grow();
+    Storage *storage = freeList.back();
+    freeList.pop_back();
+    return (new (storage) Connection(clientFd));
+}
+
+void ConnectionPool::reclaim()
+{
+    for (Connection *connection : retired)
+    {
+        connection->~Connection();
+        freeList.push_back(reinterpret_cast<Storage *>(connection));
+    }
+    retired.clear();
+}
+
+// Sized up front so admitting clients never reallocates the tables
+void ConnectionTable::reserve(size_t capacity)
+{
+    pool.reserve(capacity);
+    slots.reserve(capacity + CONNECTION_FD_HEADROOM);
+    live.reserve(capacity);
+}
+
+Connection *ConnectionTable::add(int clientFd)
+{
+    if (static_cast<size_t>(clientFd) >= slots.size())
+        slots.resize(clientFd + 1);
+
+    Slot &slot = slots[clientFd];
+    slot.connection = pool.acquire(clientFd);
+    slot.generation++;
+    slot.denseIndex = live.size();
+    live.push_back(clientFd);
+    return (slot.connection);
+}
+
+void ConnectionTable::remove(int clientFd)
+{
+    if (!get(clientFd))
+        return;
+
+    Slot &slot = slots[clientFd];
+    int moved = live.back();
+    live[slot.denseIndex] = moved;
+    slots[moved].denseIndex = slot.denseIndex;
+    live.pop_back();
+
+    pool.release(slot.connection);
+    slot.connection = NULL;
+    slot.generation++;
+}
+
+void ConnectionTable::clear()
+{
+    for (int clientFd : live)
+    {
+        pool.release(slots[clientFd].connection);
+        slots[clientFd].connection = NULL;
+        slots[clientFd].generation++;
+    }
+    live.clear();
+    pool.reclaim();
+}
@@ -0,0 +1,155 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ConnectionTable.hpp                                :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 08:08:31 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 11:33:18 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef CONNECTIONTABLE_HPP
+# define CONNECTIONTABLE_HPP
+
+# include "Client.hpp"
+# include "LineFramer.hpp"
+# include "OutputQueue.hpp"
+# include <memory>
+# include <type_traits>
+# include <vector>
+
+# define CONNECTION_SLAB	256
+// Listener, reactor, wakeup and log descriptors sit below the client fds
+# define CONNECTION_FD_HEADROOM	64
+
+// inFlight counts the bytes an asynchronous write was submitted for and has not completed yet
+struct ClientOutput
+{
+	OutputQueue	queue;
+	unsigned	inFlight;
+	bool		scheduled;
+	bool		writeArmed;
+	bool		closing;
+	time_t		behindSince;
+	time_t		closingSince;
+
+	ClientOutput() : inFlight(0), scheduled(false), writeArmed(false), closing(false), behindSince(0), closingSince(0) {}
+};
+
+// Flood credit in thousandths of a line, refilled from the monotonic clock
+# define FLOOD_UNIT	1000
+
+struct FloodBucket
+{
+	long		credit;
+	long long	refilledAt;
+	bool		throttled;
+
+	FloodBucket() : credit(0), refilledAt(0), throttled(false) {}
+};
+
+// awaiting counts the client's commands still running on other shards, all routed to awaitingShard;
+// deferred is set once a line had to wait for them
+struct Connection
+{
+	Client			client;
+	LineFramer		input;
+	ClientOutput	output;
+	FloodBucket		flood;
+	unsigned		fanoutEpoch;
+	unsigned		awaiting;
+	unsigned char	awaitingShard;
+	bool			deferred;
+	bool			runQueued;
+	bool			socketUnread;
+
+	explicit Connection(int clientFd) : client(clientFd), fanoutEpoch(0), awaiting(0), awaitingShard(0), deferred(false), runQueued(false), socketUnread(false) {}
+};
+
+// Refers to one connection, not to whichever connection later reuses its fd
+struct ClientHandle
+{
+	int			fd;
+	unsigned	generation;
+};
+
+// Connections live in fixed slabs so their addresses never move; a released
+// connection is only destroyed and reused after reclaim(), at the end of the tick
+class ConnectionPool
+{
+	private:
+		typedef std::aligned_storage<sizeof(Connection), alignof(Connection)>::type	Storage;
+
+		std::vector<std::unique_ptr<Storage[]> >	slabs;
+		std::vector<Storage *>						freeList;
+		std::vector<Connection *>					retired;
+
+		void	grow();
+
+	public:
+		explicit ConnectionPool(size_t capacity = 0);
+		~ConnectionPool();
+		ConnectionPool(const ConnectionPool &) = delete;
+		ConnectionPool &operator=(const ConnectionPool &) = delete;
+
+		void		reserve(size_t capacity);
+		Connection	*acquire(int clientFd);
+		void		release(Connection *connection) { retired.push_back(connection); }
+		void		reclaim();
+		size_t		capacity() const { return slabs.size() * CONNECTION_SLAB; }
+};
+
+// Slots are indexed by fd, live fds are kept densely for iteration
+class ConnectionTable
+{
+	private:
+		struct Slot
+		{
+			Connection	*connection;
+			unsigned	generation;
+			size_t		denseIndex;
+
+			Slot() : connection(NULL), generation(0), denseIndex(0) {}
+		};
+
+		ConnectionPool		pool;
+		std::vector<Slot>	slots;
+		std::vector<int>	live;
+
+	public:
+		ConnectionTable() {}
+		~ConnectionTable() { clear(); }
+
+		void		reserve(size_t capacity);
+
+		Connection	*add(int clientFd);
+		void		remove(int clientFd);
+		void		reclaim() { pool.reclaim(); }
+		void		clear();
+
+		Connection	*get(int clientFd) const
+		{
+			if (clientFd < 0 || static_cast<size_t>(clientFd) >= slots.size())
+				return NULL;
+			return slots[clientFd].connection;
+		}
+		Connection	*get(const ClientHandle &handle) const
+		{
+			Connection *connection = get(handle.fd);
+			if (!connection || slots[handle.fd].generation != handle.generation)
+				return NULL;
+			return connection;
+		}
+		ClientHandle	handle(int clientFd) const
+		{
+			ClientHandle result = { clientFd, slots[clientFd].generation };
+			return result;
+		}
+
+		size_t					size() const { return live.size(); }
+		const std::vector<int>	&fds() const { return live; }
+};
+
+#endif
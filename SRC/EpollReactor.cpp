@@ -0,0 +1,99 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   EpollReactor.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 07:06:12 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 07:16:20 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Reactor.hpp"
+
+#ifdef __linux__
+
+# include <cerrno>
+# include <cstring>
+# include <stdexcept>
+# include <unistd.h>
+
+static uint32_t toEpollEvents(unsigned events)
+{
+    uint32_t epollEvents = EPOLLET | EPOLLRDHUP;
+
+    if (events & Reactor::READABLE)
+        epollEvents |= EPOLLIN;
+    if (events & Reactor::WRITABLE)
+        epollEvents |= EPOLLOUT;
+    return (epollEvents);
+}
+
+EpollReactor::EpollReactor() : epollFd(-1), registered(0), events(256)
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1)
+        throw std::runtime_error("epoll_create1 failed: " + std::string(strerror(errno)));
+}
+
+EpollReactor::~EpollReactor()
+{
+    if (epollFd != -1)
+        close(epollFd);
+}
+
+bool EpollReactor::add(int fd, unsigned events)
+{
+    struct epoll_event event;
+    event.events = toEpollEvents(events);
+    event.data.fd = fd;
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1)
+        return (false);
+    registered++;
+    return (true);
+}
+
+bool EpollReactor::modify(int fd, unsigned events)
+{
+    struct epoll_event event;
+    event.events = toEpollEvents(events);
+    event.data.fd = fd;
+
+    return (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) == 0);
+}
+
+void EpollReactor::remove(int fd)
+{
+    if (epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr) == 0)
+        registered--;
+}
+
+int EpollReactor::wait(std::vector<ReactorEvent> &ready, int timeoutMs)
+{
+    ready.clear();
+    if (events.size() < registered && events.size() < 65536)
+        events.resize(events.size() * 2);
+
+    int ret = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), timeoutMs);
+    if (ret <= 0)
+        return (ret);
+
+    for (int i = 0; i < ret; ++i)
+    {
+        uint32_t revents = events[i].events;
+        unsigned mapped = 0;
+
+        if (revents & EPOLLIN)
+            mapped |= READABLE;
+        if (revents & EPOLLOUT)
+            mapped |= WRITABLE;
+        if (revents & (EPOLLHUP | EPOLLERR | EPOLLRDHUP))
+            mapped |= HANGUP;
+        ready.push_back({events[i].data.fd, mapped, nullptr, 0});
+    }
+    return (ret);
+}
+
+#endif
@@ -0,0 +1,155 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   LineFramer.cpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 07:52:02 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 11:21:27 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "LineFramer.hpp"
+#include <cstring>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+// A line ends at CR or LF, whichever comes first, so bare-CR clients are framed too
+#ifdef __SSE2__
+const char *findNewline(const char *begin, const char *end)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriage = _mm_set1_epi8('\r');
+
+    while (end - begin >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, carriage)));
+        if (mask)
+            return begin + __builtin_ctz(mask);
+        begin += 16;
+    }
+    for (; begin < end; ++begin)
+    {
+        if (*begin == '\n' || *begin == '\r')
+            return begin;
+    }
+    return NULL;
+}
+#else
+const char *findNewline(const char *begin, const char *end)
+{
+    for (; begin < end; ++begin)
+    {
+        if (*begin == '\n' || *begin == '\r')
+            return begin;
+    }
+    return NULL;
+}
+#endif
+
+char *LineFramer::prepare(size_t count)
+{
+    if (start == end)
+    {
+        start = 0;
+        end = 0;
+        scanned = 0;
+    }
+    if (buffer.size() - end < count)
+    {
+        if (start > 0)
+        {
+            std::memmove(buffer.data(), buffer.data() + start, end - start);
+            end -= start;
+            scanned -= start;
+            start = 0;
+        }
+        if (buffer.size() - end < count)
+            buffer.resize(end + count);
+    }
+    return (buffer.data() + end);
+}
+
+void LineFramer::append(const char *data, size_t length)
+{
+    std::memcpy(prepare(length), data, length);
+    commit(length);
+}
+
+bool LineFramer::next(StringView &line)
+{
+    while (true)
+    {
+        const char *base = buffer.data();
+        const char *newline = findNewline(base + scanned, base + end);
+
+        if (!newline)
+        {
+            if (discarding || end - start >= IRC_LINE_MAX)
+            {
+                if (!discarding)
+                    overflows++;
+                discarding = true;
+                start = end;
+            }
+            scanned = end;
+            return (false);
+        }
+
+        // CRLF is consumed as one terminator; a CR whose LF has not arrived yet leaves an empty line behind
+        size_t length = newline - (base + start);
+        size_t terminator = (*newline == '\r' && newline + 1 < base + end && newline[1] == '\n') ? 2 : 1;
+        size_t counted = length + (*newline == '\r' ? 2 : 1);
+        if (discarding || counted > IRC_LINE_MAX)
+        {
+            if (!discarding)
+                overflows++;
+            discarding = false;
+            start += length + terminator;
+            scanned = start;
+            continue;
+        }
+
+        line = StringView(base + start, length);
+        start += length + terminator;
+        scanned = start;
+        lastLine = static_cast<unsigned short>(length + terminator);
+        // Empty lines are ignored, they also cost nothing against the budget or flood credit
+        if (length == 0)
+            continue;
+        return (true);
+    }
+}
+
+// Puts back the line next() just returned, for a command that has to wait its turn
+void LineFramer::rewind()
+{
+    start -= lastLine;
+    scanned = start;
+    lastLine = 0;
+}
+
+// Called once a connection has nothing left to parse, so a burst does not pin its buffer
+void LineFramer::hibernate()
+{
+    if (start != end || buffer.capacity() <= FRAMER_KEEP)
+        return;
+    std::vector<char>().swap(buffer);
+    start = 0;
+    end = 0;
+    scanned = 0;
+}
+
+void LineFramer::clear()
+{
+    std::vector<char>().swap(buffer);
+    start = 0;
+    end = 0;
+    scanned = 0;
+    discarding = false;
+    lastLine = 0;
+    overflows = 0;
+}
@@ -0,0 +1,58 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   LineFramer.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 07:52:02 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 11:21:27 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef LINEFRAMER_HPP
+# define LINEFRAMER_HPP
+
+# include "StringView.hpp"
+# include <vector>
+
+# define FRAMER_RECV_BATCH 16384
+// RFC 1459 limit, CRLF included; longer lines are dropped and counted
+# define IRC_LINE_MAX 512
+// A drained buffer larger than this is released instead of kept for reuse
+# define FRAMER_KEEP 1024
+
+// Contiguous receive buffer with a read cursor. Consumed bytes are only
+// reclaimed when the tail runs out of room, so pipelined lines cost no shifting.
+// Complete lines may wait here while flood control holds a client back; an overlong line
+// is discarded up to its terminator. CR, LF and CRLF all end a line.
+class LineFramer
+{
+	private:
+		std::vector<char>	buffer;
+		size_t				start;
+		size_t				end;
+		size_t				scanned;
+		bool				discarding;
+		unsigned short		lastLine;
+		unsigned			overflows;
+
+	public:
+		LineFramer() : start(0), end(0), scanned(0), discarding(false), lastLine(0), overflows(0) {}
+
+		size_t		pending() const { return end - start; }
+		size_t		capacity() const { return buffer.capacity(); }
+		unsigned	takeOverflows() { unsigned count = overflows; overflows = 0; return count; }
+
+		char		*prepare(size_t count);
+		void		commit(size_t count) { end += count; }
+		void		append(const char *data, size_t length);
+		bool		next(StringView &line);
+		void		rewind();
+		void		hibernate();
+		void		clear();
+};
+
+const char	*findNewline(const char *begin, const char *end);
+
+#endif
@@ -0,0 +1,256 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Log.cpp                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 08:04:35 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 11:19:03 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Log.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <pthread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+std::unique_ptr<LogRecord[]>	Log::ring;
+std::atomic<size_t>				Log::tail(0);
+size_t							Log::head = 0;
+std::atomic<size_t>				Log::dropped(0);
+std::atomic<time_t>				Log::now(0);
+std::atomic<int>				Log::level(LOG_LEVEL_INFO);
+std::atomic<bool>				Log::running(false);
+std::atomic<bool>				Log::parked(false);
+int								Log::wakePipe[2] = { -1, -1 };
+std::thread						Log::writer;
+FILE							*Log::output = NULL;
+
+static const char *levelNames[] = { "TRAFFIC", "DEBUG", "INFO", "WARN", "ERROR" };
+
+int Log::parseLevel(const std::string &name)
+{
+    for (int i = LOG_LEVEL_TRAFFIC; i <= LOG_LEVEL_ERROR; i++)
+    {
+        std::string candidate = levelNames[i];
+        if (name.size() == candidate.size() && std::equal(name.begin(), name.end(), candidate.begin(),
+                [](char a, char b) { return std::toupper(static_cast<unsigned char>(a)) == b; }))
+            return (i);
+    }
+    return (-1);
+}
+
+static void stopAtExit()
+{
+    Log::stop();
+}
+
+bool Log::start(const std::string &levelName, const std::string &path)
+{
+    int parsed = parseLevel(levelName);
+    if (parsed == -1)
+    {
+        std::cerr << "Unknown log level '" << levelName << "', using info" << std::endl;
+        parsed = LOG_LEVEL_INFO;
+    }
+    level.store(parsed);
+
+    output = stdout;
+    if (!path.empty() && !(output = std::fopen(path.c_str(), "a")))
+    {
+        std::cerr << "Failed to open log file " << path << ", logging to stdout" << std::endl;
+        output = stdout;
+    }
+
+    // A pipe rather than a condition variable: producers include the signal handler
+    if (pipe(wakePipe) == -1)
+    {
+        std::cerr << "Failed to create the log wakeup pipe, logging synchronously" << std::endl;
+        return (false);
+    }
+    fcntl(wakePipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(wakePipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+
+    ring.reset(new LogRecord[LOG_RING_SIZE]);
+    for (size_t i = 0; i < LOG_RING_SIZE; i++)
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    tick();
+
+    // The writer inherits a fully blocked mask so signals always land on the event loop thread
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    running.store(true);
+    writer = std::thread(drain);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    std::atexit(stopAtExit);
+    return (true);
+}
+
+void Log::stop()
+{
+    if (!running.exchange(false))
+        return;
+    parked.store(true);
+    wake();
+    if (writer.joinable())
+        writer.join();
+    while (writeOne())
+        ;
+    std::fflush(output);
+    if (output != stdout)
+        std::fclose(output);
+    output = NULL;
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+}
+
+void Log::wake()
+{
+    char byte = 0;
+    if (parked.exchange(false))
+        while (write(wakePipe[1], &byte, 1) == -1 && errno == EINTR)
+            ;
+}
+
+// Bounded MPSC ring after Vyukov, a full ring drops the line instead of blocking the loop
+void Log::submit(int lineLevel, const char *text, size_t length)
+{
+    if (!ring)
+    {
+        std::fwrite(text, 1, length, stdout);
+        std::fputc('\n', stdout);
+        return;
+    }
+
+    size_t pos = tail.load(std::memory_order_relaxed);
+    LogRecord *record;
+    while (true)
+    {
+        record = &ring[pos & (LOG_RING_SIZE - 1)];
+        size_t sequence = record->sequence.load(std::memory_order_acquire);
+        long diff = static_cast<long>(sequence) - static_cast<long>(pos);
+        if (diff == 0)
+        {
+            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+            pos = tail.load(std::memory_order_relaxed);
+    }
+
+    record->time = now.load(std::memory_order_relaxed);
+    record->level = lineLevel;
+    record->length = length;
+    std::memcpy(record->text, text, length);
+    record->sequence.store(pos + 1, std::memory_order_release);
+
+    // Pairs with the fence in drain(): either the writer sees this record or we see it parked
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked.load(std::memory_order_relaxed))
+        wake();
+}
+
+bool Log::hasRecord()
+{
+    return (ring[head & (LOG_RING_SIZE - 1)].sequence.load(std::memory_order_acquire) == head + 1);
+}
+
+// Only the writer thread formats, it re-renders the stamp once a second at most
+static const char *formatStamp(time_t time)
+{
+    static time_t formattedTime = 0;
+    static char stamp[32] = "";
+
+    if (time != formattedTime)
+    {
+        struct tm local;
+        localtime_r(&time, &local);
+        std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+        formattedTime = time;
+    }
+    return (stamp);
+}
+
+bool Log::writeOne()
+{
+    LogRecord &record = ring[head & (LOG_RING_SIZE - 1)];
+    if (record.sequence.load(std::memory_order_acquire) != head + 1)
+        return (false);
+
+    std::fprintf(output, "%s [%s] %.*s\n", formatStamp(record.time), levelNames[record.level], static_cast<int>(record.length), record.text);
+
+    record.sequence.store(head + LOG_RING_SIZE, std::memory_order_release);
+    head++;
+    return (true);
+}
+
+void Log::drain()
+{
+    while (running.load(std::memory_order_relaxed))
+    {
+        bool wrote = false;
+        while (writeOne())
+            wrote = true;
+
+        size_t lost = dropped.exchange(0, std::memory_order_relaxed);
+        if (lost)
+            std::fprintf(output, "%s [WARN] Log ring full, dropped %zu lines\n", formatStamp(time(NULL)), lost);
+        if (wrote || lost)
+            std::fflush(output);
+
+        parked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (hasRecord() || !running.load(std::memory_order_relaxed))
+        {
+            parked.store(false, std::memory_order_relaxed);
+            continue;
+        }
+        char buffer[64];
+        while (read(wakePipe[0], buffer, sizeof(buffer)) == -1 && errno == EINTR)
+            ;
+    }
+}
+
+LogLine::~LogLine()
+{
+    while (length > 0 && (buffer[length - 1] == '\n' || buffer[length - 1] == '\r'))
+        length--;
+    Log::submit(level, buffer, length);
+}
+
+void LogLine::append(const char *data, size_t size)
+{
+    if (size > LOG_LINE_MAX - length)
+        size = LOG_LINE_MAX - length;
+    std::memcpy(buffer + length, data, size);
+    length += size;
+}
+
+void LogLine::appendNumber(long long value)
+{
+    char digits[24];
+    int size = std::snprintf(digits, sizeof(digits), "%lld", value);
+    append(digits, size);
+}
+
+void LogLine::appendUnsigned(unsigned long long value)
+{
+    char digits[24];
+    int size = std::snprintf(digits, sizeof(digits), "%llu", value);
+    append(digits, size);
+}
@@ -0,0 +1,123 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Log.hpp                                            :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 08:04:35 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 10:07:16 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef LOG_HPP
+# define LOG_HPP
+
+# include "StringView.hpp"
+# include <atomic>
+# include <cstddef>
+# include <cstdio>
+# include <cstring>
+# include <ctime>
+# include <memory>
+# include <string>
+# include <thread>
+
+# define LOG_LEVEL_TRAFFIC	0
+# define LOG_LEVEL_DEBUG		1
+# define LOG_LEVEL_INFO		2
+# define LOG_LEVEL_WARN		3
+# define LOG_LEVEL_ERROR		4
+
+// Levels below this are compiled out entirely, e.g. -DLOG_COMPILE_LEVEL=2 drops traffic and debug
+# ifndef LOG_COMPILE_LEVEL
+#  define LOG_COMPILE_LEVEL LOG_LEVEL_TRAFFIC
+# endif
+
+# define LOG_LINE_MAX	512
+# define LOG_RING_SIZE	1024
+
+# define LOG_AT(level, expr) \
+	do { \
+		if ((level) >= LOG_COMPILE_LEVEL && Log::enabled(level)) \
+		{ \
+			LogLine logLine(level); \
+			logLine << expr; \
+		} \
+	} while (0)
+
+# define LOG_TRAFFIC(expr)	LOG_AT(LOG_LEVEL_TRAFFIC, expr)
+# define LOG_DEBUG(expr)	LOG_AT(LOG_LEVEL_DEBUG, expr)
+# define LOG_INFO(expr)		LOG_AT(LOG_LEVEL_INFO, expr)
+# define LOG_WARN(expr)		LOG_AT(LOG_LEVEL_WARN, expr)
+# define LOG_ERROR(expr)	LOG_AT(LOG_LEVEL_ERROR, expr)
+
+struct LogRecord
+{
+	std::atomic<size_t>	sequence;
+	time_t				time;
+	int					level;
+	size_t				length;
+	char				text[LOG_LINE_MAX];
+};
+
+// Producers format into a fixed buffer and push it into a bounded MPSC ring,
+// a background thread does the timestamping and the blocking writes. The writer
+// sleeps on a pipe and is only woken when the ring goes from empty to non-empty.
+class Log
+{
+	private:
+		static std::unique_ptr<LogRecord[]>	ring;
+		static std::atomic<size_t>			tail;
+		static size_t						head;
+		static std::atomic<size_t>			dropped;
+		static std::atomic<time_t>			now;
+		static std::atomic<int>				level;
+		static std::atomic<bool>			running;
+		static std::atomic<bool>			parked;
+		static int							wakePipe[2];
+		static std::thread					writer;
+		static FILE							*output;
+
+		static void	drain();
+		static bool	writeOne();
+		static bool	hasRecord();
+		static void	wake();
+
+	public:
+		static bool	start(const std::string &levelName, const std::string &path);
+		static void	stop();
+		static void	tick() { now.store(time(NULL), std::memory_order_relaxed); }
+		static bool	enabled(int lineLevel) { return lineLevel >= level.load(std::memory_order_relaxed); }
+		static void	submit(int lineLevel, const char *text, size_t length);
+		static int	parseLevel(const std::string &name);
+};
+
+class LogLine
+{
+	private:
+		int		level;
+		size_t	length;
+		char	buffer[LOG_LINE_MAX];
+
+		void	append(const char *data, size_t size);
+		void	appendNumber(long long value);
+		void	appendUnsigned(unsigned long long value);
+
+	public:
+		explicit LogLine(int level) : level(level), length(0) {}
+		~LogLine();
+
+		LogLine	&operator<<(const char *str) { append(str, std::strlen(str)); return *this; }
+		LogLine	&operator<<(const std::string &str) { append(str.data(), str.size()); return *this; }
+		LogLine	&operator<<(const StringView &view) { append(view.data(), view.size()); return *this; }
+		LogLine	&operator<<(char c) { append(&c, 1); return *this; }
+		LogLine	&operator<<(int value) { appendNumber(value); return *this; }
+		LogLine	&operator<<(long value) { appendNumber(value); return *this; }
+		LogLine	&operator<<(long long value) { appendNumber(value); return *this; }
+		LogLine	&operator<<(unsigned int value) { appendUnsigned(value); return *this; }
+		LogLine	&operator<<(unsigned long value) { appendUnsigned(value); return *this; }
+		LogLine	&operator<<(unsigned long long value) { appendUnsigned(value); return *this; }
+};
+
+#endif
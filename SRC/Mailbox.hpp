@@ -0,0 +1,73 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Mailbox.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 11:47:55 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 11:47:55 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef MAILBOX_HPP
+# define MAILBOX_HPP
+
+# include <atomic>
+# include <utility>
+
+// Unbounded multi-producer, single-consumer queue (Vyukov). Any thread may push,
+// only the owning thread pops. A push is one exchange and one store, no lock;
+// a pop can miss a node whose producer has not linked it yet, that producer wakes
+// the consumer again once it has.
+template <typename T>
+class Mailbox
+{
+	private:
+		struct Node
+		{
+			std::atomic<Node *>	next;
+			T					value;
+
+			Node() : next(nullptr) {}
+		};
+
+		Node				*head;
+		std::atomic<Node *>	tail;
+
+		Mailbox(const Mailbox &);
+		Mailbox &operator=(const Mailbox &);
+
+	public:
+		Mailbox() : head(new Node()), tail(head) {}
+		~Mailbox()
+		{
+			while (head)
+			{
+				Node *next = head->next.load(std::memory_order_relaxed);
+				delete head;
+				head = next;
+			}
+		}
+
+		void push(T value)
+		{
+			Node *node = new Node();
+			node->value = std::move(value);
+			Node *previous = tail.exchange(node, std::memory_order_acq_rel);
+			previous->next.store(node, std::memory_order_release);
+		}
+
+		bool pop(T &value)
+		{
+			Node *next = head->next.load(std::memory_order_acquire);
+			if (!next)
+				return (false);
+			value = std::move(next->value);
+			delete head;
+			head = next;
+			return (true);
+		}
+};
+
+#endif
@@ -0,0 +1,127 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   OutputQueue.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 07:37:14 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 11:41:51 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "OutputQueue.hpp"
+#include <algorithm>
+
+void OutputQueue::append(const SharedMessage &message)
+{
+    if (!message || message->empty())
+        return;
+    segments.push_back(message);
+    bytes += message->size();
+}
+
+// Private replies are copied into one owned segment; it never grows past its
+// reserved capacity, so bytes already handed to writev or a backend stay put.
+// The segment is dropped once drained, an idle connection keeps nothing.
+void OutputQueue::append(const char *data, size_t length)
+{
+    if (length == 0)
+        return;
+
+    bool open = tail && head < segments.size() && segments.back() == tail
+        && tail->capacity() - tail->size() >= length;
+    if (!open)
+    {
+        tail = std::make_shared<std::string>();
+        tail->reserve(std::max(static_cast<size_t>(OUTPUT_TAIL_CHUNK), length));
+        segments.push_back(tail);
+    }
+    tail->append(data, length);
+    bytes += length;
+}
+
+int OutputQueue::fillIovec(struct iovec *iov, int max) const
+{
+    int count = 0;
+    size_t skip = offset;
+
+    for (auto it = segments.begin() + head; it != segments.end() && count < max; ++it)
+    {
+        iov[count].iov_base = const_cast<char *>((*it)->data() + skip);
+        iov[count].iov_len = (*it)->size() - skip;
+        skip = 0;
+        count++;
+    }
+    return (count);
+}
+
+// Keeps the first count segments alive for a write that completes after the queue moved on
+void OutputQueue::pin(std::vector<SharedMessage> &pinned, int count) const
+{
+    pinned.assign(segments.begin() + head, segments.begin() + head + count);
+}
+
+void OutputQueue::consume(size_t count)
+{
+    if (count > bytes)
+        count = bytes;
+    bytes -= count;
+
+    while (count > 0)
+    {
+        size_t available = segments[head]->size() - offset;
+        if (count < available)
+        {
+            offset += count;
+            return;
+        }
+        count -= available;
+        segments[head++].reset();
+        offset = 0;
+    }
+
+    if (head == segments.size())
+        clear();
+    else if (head > 32 && head * 2 > segments.size())
+    {
+        segments.erase(segments.begin(), segments.begin() + head);
+        head = 0;
+    }
+}
+
+// Drops the segments past the first keep bytes. A partly written head segment is
+// always kept, so the peer never sees a line cut short
+void OutputQueue::truncate(size_t keep)
+{
+    size_t end = head;
+    size_t kept = 0;
+    size_t skip = offset;
+
+    while (end < segments.size() && (kept < keep || skip > 0))
+    {
+        kept += segments[end]->size() - skip;
+        skip = 0;
+        end++;
+    }
+    if (end == head)
+    {
+        clear();
+        return;
+    }
+    tail.reset();
+    segments.erase(segments.begin() + end, segments.end());
+    bytes = kept;
+}
+
+void OutputQueue::clear()
+{
+    if (segments.capacity() > OUTPUT_KEEP_SEGMENTS)
+        std::vector<SharedMessage>().swap(segments);
+    else
+        segments.clear();
+    tail.reset();
+    head = 0;
+    offset = 0;
+    bytes = 0;
+}
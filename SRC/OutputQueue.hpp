@@ -0,0 +1,56 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   OutputQueue.hpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 07:37:14 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 11:41:51 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef OUTPUTQUEUE_HPP
+# define OUTPUTQUEUE_HPP
+
+# include <memory>
+# include <string>
+# include <sys/uio.h>
+# include <vector>
+
+# define OUTPUT_IOV_BATCH 256
+# define OUTPUT_TAIL_CHUNK 2048
+// A drained segment list longer than this is released instead of kept for reuse
+# define OUTPUT_KEEP_SEGMENTS 16
+
+// Serialized once per broadcast, every recipient queue holds a reference
+typedef std::shared_ptr<const std::string>	SharedMessage;
+
+// Segments are consumed from a head index instead of a deque, so an idle
+// connection's queue owns no heap memory at all
+class OutputQueue
+{
+	private:
+		std::vector<SharedMessage>		segments;
+		std::shared_ptr<std::string>	tail;
+		size_t							head;
+		size_t							offset;
+		size_t							bytes;
+
+	public:
+		OutputQueue() : head(0), offset(0), bytes(0) {}
+
+		bool	empty() const { return bytes == 0; }
+		size_t	size() const { return bytes; }
+		size_t	reserved() const { return segments.capacity() * sizeof(SharedMessage) + (tail ? tail->capacity() : 0); }
+
+		void	append(const SharedMessage &message);
+		void	append(const char *data, size_t length);
+		int		fillIovec(struct iovec *iov, int max) const;
+		void	pin(std::vector<SharedMessage> &pinned, int count) const;
+		void	consume(size_t count);
+		void	truncate(size_t keep);
+		void	clear();
+};
+
+#endif
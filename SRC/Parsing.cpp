@@ -12,26 +12,49 @@
 
 #include "Parsing.hpp"
 
-cmd_syntax parseIrcMessage(const std::string& raw_msg) 
+static StringView nextToken(StringView &rest)
 {
-    cmd_syntax parsed;
-    std::istringstream stream(raw_msg);
+    size_t end = rest.find(' ');
+    StringView token = rest.substr(0, end);
+    rest.removePrefix(token.size());
+    while (!rest.empty() && rest.front() == ' ')
+        rest.removePrefix(1);
+    return token;
+}
+
+// Single pass over [@tags] [:prefix] command params [:trailing], no allocation
+bool parseIrcMessage(const StringView &line, cmd_syntax &parsed)
+{
+    StringView rest = line;
+    while (!rest.empty() && rest.front() == ' ')
+        rest.removePrefix(1);
 
-    if (raw_msg[0] == ':') 
+    if (!rest.empty() && rest.front() == '@')
     {
-        stream >> parsed.prefix;
-        parsed.prefix = parsed.prefix.substr(1);
+        parsed.tags = nextToken(rest);
+        parsed.tags.removePrefix(1);
     }
-    stream >> parsed.name;
+    if (!rest.empty() && rest.front() == ':')
+    {
+        parsed.prefix = nextToken(rest);
+        parsed.prefix.removePrefix(1);
+    }
+
+    parsed.name = nextToken(rest);
+    if (parsed.name.empty())
+        return false;
 
-    std::string param;
-    while (stream >> param) {
-        if (param[0] == ':') {
-            parsed.message = raw_msg.substr(raw_msg.find(param) + 1);
+    while (!rest.empty())
+    {
+        if (rest.front() == ':' || parsed.params.full())
+        {
+            if (rest.front() == ':')
+                rest.removePrefix(1);
+            parsed.message = rest;
+            parsed.hasTrailing = true;
             break;
-        } else {
-            parsed.params.push_back(param);
         }
+        parsed.params.push_back(nextToken(rest));
     }
-    return parsed;
+    return true;
 }
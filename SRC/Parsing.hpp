@@ -1,30 +1,53 @@
-/* ************************************************************************** */
-/*                                                                            */
-/*                                                        :::      ::::::::   */
-/*   Parsing.hpp                                        :+:      :+:    :+:   */
-/*                                                    +:+ +:+         +:+     */
-/*   By: dbejar-s <dbejar-s@student.hive.fi>        +#+  +:+       +#+        */
-/*                                                +#+#+#+#+#+   +#+           */
-/*   Created: 2025/04/25 11:22:09 by dbejar-s          #+#    #+#             */
-/*   Updated: 2025/04/25 11:22:09 by dbejar-s         ###   ########.fr       */
-/*                                                                            */
-/* ************************************************************************** */
-
-#ifndef PARSING_HPP
-# define PARSING_HPP
-
-# include <iostream>
-# include <sstream>
-# include <vector>
-# include <string>
-
-struct cmd_syntax {
-    std::string prefix;
-    std::string name;
-    std::vector<std::string> params;
-    std::string message;
-};
-
-cmd_syntax parseIrcMessage(const std::string&);
-
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Parsing.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: dbejar-s <dbejar-s@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2025/04/25 11:22:09 by dbejar-s          #+#    #+#             */
+/*   Updated: 2025/04/25 11:22:09 by dbejar-s         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef PARSING_HPP
+# define PARSING_HPP
+
+# include "StringView.hpp"
+# include <iostream>
+# include <string>
+
+// RFC 1459 allows 15 parameters, the last one may be the trailing parameter
+# define MAX_PARAMS 15
+
+class ParamList
+{
+	private:
+		StringView	items[MAX_PARAMS - 1];
+		size_t		count;
+
+	public:
+		ParamList() : count(0) {}
+
+		bool				empty() const { return count == 0; }
+		size_t				size() const { return count; }
+		bool				full() const { return count == MAX_PARAMS - 1; }
+		const StringView	&operator[](size_t index) const { return items[index]; }
+		void				push_back(const StringView &param) { items[count++] = param; }
+};
+
+// Every field is a view into the framed line and is only valid while it is being dispatched
+struct cmd_syntax {
+    StringView tags;
+    StringView prefix;
+    StringView name;
+    ParamList params;
+    StringView message;
+    bool hasTrailing;
+
+    cmd_syntax() : hasTrailing(false) {}
+};
+
+bool parseIrcMessage(const StringView &line, cmd_syntax &parsed);
+
 #endif
\ No newline at end of file
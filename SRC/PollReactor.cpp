@@ -0,0 +1,89 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   PollReactor.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 07:06:12 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 07:16:20 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Reactor.hpp"
+#include <cerrno>
+
+static short toPollEvents(unsigned events)
+{
+    short pollEvents = 0;
+
+    if (events & Reactor::READABLE)
+        pollEvents |= POLLIN;
+    if (events & Reactor::WRITABLE)
+        pollEvents |= POLLOUT;
+    return (pollEvents);
+}
+
+bool PollReactor::add(int fd, unsigned events)
+{
+    if (fd < 0)
+        return (false);
+    if (static_cast<size_t>(fd) >= slots.size())
+        slots.resize(fd + 1, -1);
+    if (slots[fd] != -1)
+        return (modify(fd, events));
+
+    slots[fd] = static_cast<int>(pollfds.size());
+    pollfds.push_back({fd, toPollEvents(events), 0});
+    return (true);
+}
+
+bool PollReactor::modify(int fd, unsigned events)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= slots.size() || slots[fd] == -1)
+        return (false);
+    pollfds[slots[fd]].events = toPollEvents(events);
+    return (true);
+}
+
+void PollReactor::remove(int fd)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= slots.size() || slots[fd] == -1)
+        return;
+
+    int index = slots[fd];
+    int last = static_cast<int>(pollfds.size()) - 1;
+    if (index != last)
+    {
+        pollfds[index] = pollfds[last];
+        slots[pollfds[index].fd] = index;
+    }
+    pollfds.pop_back();
+    slots[fd] = -1;
+}
+
+int PollReactor::wait(std::vector<ReactorEvent> &ready, int timeoutMs)
+{
+    ready.clear();
+
+    int ret = poll(pollfds.data(), pollfds.size(), timeoutMs);
+    if (ret <= 0)
+        return (ret);
+
+    for (size_t i = 0; i < pollfds.size() && ready.size() < static_cast<size_t>(ret); ++i)
+    {
+        short revents = pollfds[i].revents;
+        if (!revents)
+            continue;
+
+        unsigned events = 0;
+        if (revents & POLLIN)
+            events |= READABLE;
+        if (revents & POLLOUT)
+            events |= WRITABLE;
+        if (revents & (POLLHUP | POLLERR | POLLNVAL))
+            events |= HANGUP;
+        ready.push_back({pollfds[i].fd, events, nullptr, 0});
+    }
+    return (static_cast<int>(ready.size()));
+}
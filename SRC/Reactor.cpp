@@ -0,0 +1,56 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Reactor.cpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 07:06:12 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 08:04:35 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Reactor.hpp"
+#include "Log.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+
+Reactor *Reactor::create(const std::string &backend)
+{
+#ifdef IRCSERV_HAVE_IO_URING
+    if (backend == "io_uring")
+    {
+        try
+        {
+            return (new UringReactor());
+        }
+        catch (const std::exception &e)
+        {
+            LOG_WARN(e.what() << ". Falling back to epoll");
+        }
+    }
+#endif
+#ifdef __linux__
+    if (backend == "epoll" || backend == "io_uring")
+    {
+        try
+        {
+            return (new EpollReactor());
+        }
+        catch (const std::exception &e)
+        {
+            LOG_WARN(e.what() << ". Falling back to poll()");
+        }
+    }
+#endif
+    if (backend != "poll" && backend != "epoll" && backend != "io_uring")
+        LOG_WARN("Unknown event backend '" << backend << "'. Falling back to poll()");
+    return (new PollReactor());
+}
+
+void Reactor::disconnect(int fd)
+{
+    remove(fd);
+    close(fd);
+}
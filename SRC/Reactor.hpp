@@ -0,0 +1,187 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Reactor.hpp                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 07:06:12 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 11:41:51 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef REACTOR_HPP
+# define REACTOR_HPP
+
+# include <deque>
+# include <string>
+# include <vector>
+# include <poll.h>
+# include <sys/uio.h>
+# include <sys/socket.h>
+# include "OutputQueue.hpp"
+
+struct ReactorEvent
+{
+	int			fd;
+	unsigned	events;
+	const char	*data;
+	size_t		length;
+};
+
+class Reactor
+{
+	public:
+		enum
+		{
+			READABLE = 1 << 0,
+			WRITABLE = 1 << 1,
+			HANGUP = 1 << 2,
+			ACCEPTED = 1 << 3,
+			DATA = 1 << 4,
+			WRITTEN = 1 << 5
+		};
+
+		virtual ~Reactor() {}
+
+		virtual const char	*name() const = 0;
+		virtual bool		add(int fd, unsigned events) = 0;
+		virtual bool		modify(int fd, unsigned events) = 0;
+		virtual void		remove(int fd) = 0;
+		virtual int			wait(std::vector<ReactorEvent> &ready, int timeoutMs) = 0;
+
+		virtual bool		addListener(int fd) { return add(fd, READABLE); }
+		virtual bool		asyncWrites() const { return false; }
+		virtual bool		submitWrite(int fd, const struct iovec *iov, int count, std::vector<SharedMessage> &segments) { (void)fd; (void)iov; (void)count; (void)segments; return false; }
+		virtual void		disconnect(int fd);
+
+		static Reactor		*create(const std::string &backend);
+};
+
+class PollReactor : public Reactor
+{
+	private:
+		std::vector<struct pollfd>	pollfds;
+		std::vector<int>			slots;
+
+	public:
+		const char	*name() const { return "poll"; }
+		bool		add(int fd, unsigned events);
+		bool		modify(int fd, unsigned events);
+		void		remove(int fd);
+		int			wait(std::vector<ReactorEvent> &ready, int timeoutMs);
+};
+
+# ifdef __linux__
+#  include <sys/epoll.h>
+
+class EpollReactor : public Reactor
+{
+	private:
+		int								epollFd;
+		size_t							registered;
+		std::vector<struct epoll_event>	events;
+
+		EpollReactor(const EpollReactor &);
+		EpollReactor &operator=(const EpollReactor &);
+
+	public:
+		EpollReactor();
+		~EpollReactor();
+
+		const char	*name() const { return "epoll"; }
+		bool		add(int fd, unsigned events);
+		bool		modify(int fd, unsigned events);
+		void		remove(int fd);
+		int			wait(std::vector<ReactorEvent> &ready, int timeoutMs);
+};
+
+#  if defined(__has_include)
+#   if __has_include(<linux/io_uring.h>)
+#    define IRCSERV_HAVE_IO_URING
+#   endif
+#  endif
+# endif
+
+# ifdef IRCSERV_HAVE_IO_URING
+#  include <linux/io_uring.h>
+
+class UringReactor : public Reactor
+{
+	private:
+		// The kernel reads the iovecs and the segments behind them until the CQE arrives
+		struct WriteSlot
+		{
+			struct msghdr				message;
+			std::vector<struct iovec>	iov;
+			std::vector<SharedMessage>	segments;
+			bool						inFlight;
+			bool						stale;
+			bool						retry;
+
+			WriteSlot() : message(), inFlight(false), stale(false), retry(false) {}
+		};
+
+		int							ringFd;
+		void						*sqRing;
+		void						*cqRing;
+		struct io_uring_sqe			*sqes;
+		size_t						sqRingSize;
+		size_t						cqRingSize;
+		size_t						sqesSize;
+		unsigned					*sqHead;
+		unsigned					*sqTail;
+		unsigned					sqMask;
+		unsigned					*sqArray;
+		unsigned					*cqHead;
+		unsigned					*cqTail;
+		unsigned					cqMask;
+		struct io_uring_cqe			*cqes;
+		unsigned					pendingSubmit;
+
+		struct io_uring_buf_ring	*bufRing;
+		char						*bufPool;
+		unsigned					bufCount;
+		unsigned					bufSize;
+		std::vector<unsigned short>	usedBuffers;
+
+		int							listenerFd;
+		bool						multishotAccept;
+		bool						multishotRecv;
+		std::vector<unsigned>		generations;
+		std::vector<bool>			receiving;
+		std::vector<int>			starved;
+		// Grows without moving a slot a queued SQE still points to
+		std::deque<WriteSlot>		writeSlots;
+
+		UringReactor(const UringReactor &);
+		UringReactor &operator=(const UringReactor &);
+
+		void				setupRing(unsigned entries);
+		void				setupBufferRing();
+		void				probeOpcodes();
+		struct io_uring_sqe	*nextSqe();
+		int					submit(unsigned waitFor, int timeoutMs);
+		unsigned			generation(int fd);
+		void				armAccept();
+		void				armRecv(int fd);
+		void				armPoll(int fd);
+		void				recycleBuffers();
+		void				release();
+
+	public:
+		UringReactor();
+		~UringReactor();
+
+		const char	*name() const { return "io_uring"; }
+		bool		add(int fd, unsigned events);
+		bool		modify(int fd, unsigned events);
+		void		remove(int fd);
+		int			wait(std::vector<ReactorEvent> &ready, int timeoutMs);
+		bool		addListener(int fd);
+		bool		asyncWrites() const { return true; }
+		bool		submitWrite(int fd, const struct iovec *iov, int count, std::vector<SharedMessage> &segments);
+};
+# endif
+
+#endif
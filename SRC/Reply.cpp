@@ -0,0 +1,41 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Reply.cpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 08:52:06 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 08:52:06 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Reply.hpp"
+#include <algorithm>
+#include <cstdio>
+
+Reply::Reply(const StringView &source, const char *command) : length(0)
+{
+    *this << ':' << source << ' ' << command;
+}
+
+Reply::Reply(const StringView &source, const char *command, const StringView &target) : length(0)
+{
+    *this << ':' << source << ' ' << command << ' ' << target;
+}
+
+Reply &Reply::operator<<(const StringView &text)
+{
+    size_t count = std::min(text.size(), REPLY_MAX - 2 - length);
+    std::memcpy(buffer + length, text.data(), count);
+    length += count;
+    terminate();
+    return (*this);
+}
+
+Reply &Reply::operator<<(long number)
+{
+    char digits[24];
+    int count = snprintf(digits, sizeof(digits), "%ld", number);
+    return (*this << StringView(digits, count));
+}
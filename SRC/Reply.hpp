@@ -0,0 +1,48 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   Reply.hpp                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 08:52:06 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 08:52:06 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef REPLY_HPP
+# define REPLY_HPP
+
+# include "StringView.hpp"
+# include "OutputQueue.hpp"
+# include <string>
+
+// RFC 1459 line limit, CRLF included
+# define REPLY_MAX	512
+
+// Formats one outgoing line on the stack; text past the line limit is cut off
+class Reply
+{
+	private:
+		char	buffer[REPLY_MAX];
+		size_t	length;
+
+		void	terminate() { buffer[length] = '\r'; buffer[length + 1] = '\n'; }
+
+	public:
+		Reply() : length(0) { terminate(); }
+		Reply(const StringView &source, const char *command);
+		Reply(const StringView &source, const char *command, const StringView &target);
+
+		Reply	&operator<<(const StringView &text);
+		Reply	&operator<<(const std::string &text) { return *this << StringView(text); }
+		Reply	&operator<<(const char *text) { return *this << StringView(text); }
+		Reply	&operator<<(char c) { return *this << StringView(&c, 1); }
+		Reply	&operator<<(long number);
+		Reply	&operator<<(int number) { return *this << static_cast<long>(number); }
+
+		StringView		line() const { return StringView(buffer, length + 2); }
+		SharedMessage	share() const { return std::make_shared<const std::string>(buffer, length + 2); }
+};
+
+#endif
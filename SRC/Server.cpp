@@ -18,17 +18,53 @@
 
 Server *serverInstance = nullptr;
 
-Server::Server(int port, const std::string &password) 
-    : port(port), password(password), serverSocket(-1), running(false)
+Server::Server(int port, const std::string &password, const ServerConfig &config)
+    : Server(port, password, config, std::make_shared<ShardGroup>(), 0)
 {
-    std::cout << "Initializing server on port " << port << " with password " << password << std::endl;
+}
+
+Server::Server(int port, const std::string &password, const ServerConfig &config, const std::shared_ptr<ShardGroup> &group, unsigned shardIndex)
+    : port(port), password(password), serverSocket(-1), running(false), config(config), fanoutEpoch(0), recvScratch(FRAMER_RECV_BATCH), acceptPending(false), lastBufferStats(time(NULL)),
+      group(group), shardIndex(shardIndex), wakeFd(-1), inboxBacklog(false), dispatchRoute(ROUTE_ALONE)
+{
+#ifndef __linux__
+    this->config.shards = 1;
+#endif
+    group->servers.push_back(this);
+    wakeDue.resize(this->config.shards);
+    outgoing.resize(this->config.shards);
+    reactor.reset(Reactor::create(this->config.backend));
+    if (shardIndex == 0)
+    {
+        LOG_INFO("Initializing server on port " << port << " with password " << password);
+        LOG_INFO("Using " << reactor->name() << " event backend on " << this->config.shards << " shard(s)");
+        raiseFileLimit();
+    }
 
-	retrieveHostname();
+    // Every shard has room for its share, the limit itself is counted across all of them
+    size_t share = (this->config.maxClients + this->config.shards - 1) / this->config.shards;
+    connections.reserve(share);
+    nicknames.reserve(share);
+    if (shardIndex == 0)
+        LOG_INFO("Room for " << this->config.maxClients << " clients: " << sizeof(Connection) << " bytes per connection slab entry, "
+            << sizeof(ClientProfile) << " bytes per client profile");
+    retrieveHostname();
+    serializeStaticReplies();
     setupSocket();
+    if (this->config.shards > 1)
+        setupWakeup();
+
+    // The other shards bind the same port once this one holds it
+    if (shardIndex == 0)
+    {
+        for (unsigned shard = 1; shard < this->config.shards; shard++)
+            peers.emplace_back(new Server(port, password, this->config, group, shard));
+    }
 }
 
 Server::~Server()
 {
+    stopShards();
 	closeServer();
 }
 
@@ -40,490 +76,820 @@ void	Server::retrieveHostname()
         if (gethostname(buffer.data(), buffer.size()) == 0)
 		{
             hostname = std::string(buffer.data());
-            std::cout << "Server hostname: " << hostname << std::endl;
+            LOG_INFO("Server hostname: " << hostname);
         } 
 		else
             throw std::runtime_error("Failed to retrieve hostname: " + std::string(strerror(errno)));
     }
 	catch (const std::exception &e)
 	{
-        std::cerr << e.what() << std::endl;
+        LOG_WARN(e.what());
         hostname = "localhost";
     }
 }
 
-void Server::handleIncomingMessage(const std::string &message, int clientFd) {
-    cmd_syntax parsed = parseIrcMessage(message);
+// The banner and INFO text never change, every client gets a reference to the same bytes
+void Server::serializeStaticReplies()
+{
+    std::string asciiArt = R"(
+    
+██╗  ██╗ ██████╗ ██╗      █████╗ 
+██║  ██║██╔═══██╗██║     ██╔══██╗
+███████║██║   ██║██║     ███████║
+██╔══██║██║   ██║██║     ██╔══██║
+██║  ██║╚██████╔╝███████╗██║  ██║
+╚═╝  ╚═╝ ╚═════╝ ╚══════╝╚═╝  ╚═╝
+
+NOTICE: THIS SERVER MANAGES UP TO )";
+    std::string usage = R"( CLIENTS! 
 
-    auto it = std::find_if(clients.begin(), clients.end(), [clientFd](const Client &client) {
-        return client.getClientFd() == clientFd;
-    });
+Type /JOIN channel_name to create/join a channel
+or '/INFO' for a list of commands ('INFO' from netcat)
+
+    )";
+    welcomeBanner = std::make_shared<const std::string>(asciiArt + std::to_string(config.maxClients) + usage + "\r\n");
+
+    std::string info =
+    "375 :- INFO Command List -\r\n"
+    "372 :- NICK nickname - Set your nickname\r\n"
+    "372 :- USER username hostname servername :realname - Register your username\r\n"
+    "372 :- JOIN #channel - Join a channel\r\n"
+    "372 :- PART #channel - Leave a channel\r\n"
+    "372 :- PRIVMSG target message - Send a private message to a user or channel\r\n"
+    "372 :- MODE #channel mode - Set channel modes\r\n"
+    "372 :- TOPIC #channel topic - Set the topic for a channel\r\n"
+    "372 :- KICK #channel target - Kick a user from a channel\r\n"
+    "372 :- INVITE target #channel - Invite a user to a channel\r\n"
+    "372 :- QUIT message - Disconnect from the server\r\n"
+    "372 :- INFO - Show this help message\r\n"
+    "376 :- End of INFO list\r\n";
+    infoText = std::make_shared<const std::string>(info);
+}
+
+// Returns the flood credit the line spent, in lines, or LINE_DEFERRED for a line that has to wait
+unsigned Server::handleIncomingMessage(const StringView &message, int clientFd) {
+    cmd_syntax parsed;
+    if (!parseIrcMessage(message, parsed))
+        return (1);
 
-    if (parsed.name == "CAP") {
-        it->setCapNegotiation(true);
+    Connection *connection = connections.get(clientFd);
+    if (!connection)
+        return (0);
+    Client *client = &connection->client;
+
+    CommandSpec *command = findCommand(parsed.name);
+    if (!command)
+    {
+        if (client->isCapNegotiating())
+            LOG_WARN("Ignoring command " << parsed.name << " during CAP negotiation for client " << clientFd);
+        else
+            LOG_WARN("Unknown command: " << parsed.name);
+        return (1);
     }
-    
-    if (it != clients.end() && it->isCapNegotiating()) {
-        if (parsed.name != "CAP" && parsed.name != "PASS" && parsed.name != "NICK" && parsed.name != "USER" &&
-            parsed.name != "JOIN" && parsed.name != "PART" && parsed.name != "PRIVMSG" && parsed.name != "PING" &&
-            parsed.name != "QUIT" && parsed.name != "INFO" && parsed.name != "WHO" && parsed.name != "KICK" &&
-            parsed.name != "INVITE" && parsed.name != "TOPIC" && parsed.name != "MODE") {
-            std::cerr << "Ignoring command " << parsed.name << " during CAP negotiation for client " << clientFd << std::endl;
-            return;
-        }
+
+    // While commands of this client run on another shard, only more commands for that same shard may
+    // follow them there; the rest waits, so the client sees its replies in the order it sent the lines
+    bool registered = !command->requiresRegistration || client->isWelcomeSent();
+    bool complete = parsed.params.size() + (parsed.hasTrailing ? 1 : 0) >= command->minParams;
+    unsigned route = ROUTE_ALONE;
+    if (config.shards > 1 && registered && complete && command->route)
+        route = command->route(this, clientFd, parsed);
+    if (connection->awaiting && (route == ROUTE_ALONE || route != connection->awaitingShard))
+        return (LINE_DEFERRED);
+
+    // Registration is free; NICK only costs once a change is broadcast to neighbours
+    unsigned cost = (command->handler == nick && !client->isWelcomeSent()) ? 0 : command->cost;
+    if (command->handler == cap)
+        client->setCapNegotiation(true);
+    if (!registered)
+    {
+        sendReply(clientFd, numeric(clientFd, "451") << ' ' << command->name << " :You have not registered");
+        return (cost);
+    }
+    if (!complete)
+    {
+        sendReply(clientFd, numeric(clientFd, "461") << ' ' << command->name << " :Not enough parameters");
+        return (cost);
     }
 
-    if (parsed.name == "CAP")
-        cap(this, clientFd, parsed);
-    else if (parsed.name == "PASS")
-        pass(this, clientFd, parsed);
-    else if (parsed.name == "NICK")
-        nick(this, clientFd, parsed);
-    else if (parsed.name == "USER")
-        user(this, clientFd, parsed);
-    else if (parsed.name == "JOIN")
-        join(this, clientFd, parsed);
-    else if (parsed.name == "PART")
-        part(this, clientFd, parsed);
-    else if (parsed.name == "PRIVMSG")
-        privmsg(this, clientFd, parsed);
-    else if (parsed.name == "PING")
-        ping(this, clientFd, parsed);
-    else if (parsed.name == "QUIT")
-        quit(this, clientFd, parsed);
-    else if (parsed.name == "info" || parsed.name == "INFO")
-        help(this, clientFd, parsed);
-    else if (parsed.name == "WHO")
-        who(this, clientFd, parsed);
-	else if (parsed.name == "KICK")
-		kick(this, clientFd, parsed);
-	else if (parsed.name == "INVITE")
-		invite(this, clientFd, parsed);
-	else if (parsed.name == "TOPIC")
-		topic(this, clientFd, parsed);
-    else if (parsed.name == "MODE")
-		mode(this, clientFd, parsed);
-	else
-        std::cerr << "Unknown command: " << parsed.name << std::endl;
-
-    if (it != clients.end() && it->isAuthenticated() && !it->getNickname().empty() && !it->getUsername().empty() && !it->isWelcomeSent())
+    command->calls.fetch_add(1, std::memory_order_relaxed);
+    dispatchRoute = route;
+    command->handler(this, clientFd, parsed);
+    dispatchRoute = ROUTE_ALONE;
+    maybeWelcome(clientFd);
+    return (cost);
+}
+
+void Server::maybeWelcome(int clientFd) {
+    Client *client = getClient(clientFd);
+    if (client && client->isAuthenticated() && !client->getNickname().empty() && !client->getUsername().empty() && !client->isWelcomeSent())
 	{
-        sendWelcomeMessage(clientFd, *it);
-        it->setWelcomeSent(true);
+        sendWelcomeMessage(clientFd, *client);
+        client->setWelcomeSent(true);
     }
 }
 
+// The shard owning the nickname claims it and answers the client's own shard, see nicknameResolved
 void Server::handleNickCommand(int clientFd, const std::string &nickname) {
 
-    auto it = std::find_if(clients.begin(), clients.end(), [clientFd](const Client &client) {
-        return client.getClientFd() == clientFd;
+    Client *client = getClient(clientFd);
+
+    if (client) {
+        if (nickname.size() > NICKLEN) {
+            sendReply(clientFd, numeric(clientFd, "432") << ' ' << nickname << " :Erroneous nickname");
+            return;
+        }
+
+        beginOp(clientFd);
+        ClientRef ref = refOf(clientFd);
+        std::string previous = client->getNickname();
+        runOn(ownerOf(nickname), [ref, nickname, previous](Server &owner) {
+            owner.claimNickname(ref, nickname, previous);
+        });
+    } else {
+        LOG_WARN("Client " << clientFd << " not found");
+    }
+}
+
+bool Server::findNickname(const std::string &nickname, ClientRef &ref) const {
+    auto it = nicknames.find(ircLower(nickname));
+    if (it == nicknames.end())
+        return (false);
+    ref = it->second;
+    return (true);
+}
+
+// The casemapped names of those nicknames this shard has claimed
+std::vector<std::string> Server::knownNicknames(const std::vector<std::string> &names) const {
+    std::vector<std::string> known;
+    for (const std::string &name : names)
+    {
+        std::string folded = ircLower(name);
+        if (nicknames.count(folded))
+            known.push_back(folded);
+    }
+    return (known);
+}
+
+// Collisions get '_' appended, the hint remembers how many so a reconnect storm does not re-probe from one.
+// The base's shard counts the hint, each candidate is checked on the shard that owns it
+void Server::claimNickname(const ClientRef &ref, const std::string &nickname, const std::string &previous) {
+    std::string folded = ircLower(nickname);
+    auto owner = nicknames.find(folded);
+    if (owner == nicknames.end() || owner->second == ref)
+    {
+        takeNickname(ref, folded, nickname, previous);
+        return;
+    }
+    retryNickname(ref, nickname, previous);
+}
+
+void Server::retryNickname(const ClientRef &ref, const std::string &nickname, const std::string &previous) {
+    size_t hint = ++nickSuffixHint[ircLower(nickname)];
+    std::string candidate;
+    // Underscores while the base keeps a character, then a numeric suffix, all within NICKLEN
+    if (hint < NICKLEN)
+        candidate = nickname.substr(0, NICKLEN - hint) + std::string(hint, '_');
+    else
+    {
+        std::string number = std::to_string(hint);
+        candidate = nickname.substr(0, NICKLEN - number.size()) + number;
+    }
+    runOn(ownerOf(candidate), [ref, nickname, candidate, hint, previous](Server &owner) {
+        owner.probeNickname(ref, nickname, candidate, hint, previous);
     });
+}
 
-    if (it != clients.end()) {
-        std::string oldNickname = it->getNickname();
-        std::string finalNickname = nickname;
+void Server::probeNickname(const ClientRef &ref, const std::string &nickname, const std::string &candidate, size_t hint, const std::string &previous) {
+    std::string folded = ircLower(candidate);
+    auto owner = nicknames.find(folded);
+    if (owner != nicknames.end() && owner->second != ref)
+    {
+        runOn(ownerOf(nickname), [ref, nickname, previous](Server &base) {
+            base.retryNickname(ref, nickname, previous);
+        });
+        return;
+    }
+    suffixedNicks[folded] = NickSuffix{ircLower(nickname), hint};
+    takeNickname(ref, folded, candidate, previous);
+}
 
-        while (std::find_if(clients.begin(), clients.end(), [&finalNickname](const Client &client) {
-                   return client.getNickname() == finalNickname;
-               }) != clients.end()) {
-            finalNickname += "_";
-        }
+// Asking for the nickname the client already has changes nothing, its shard answers 433
+void Server::takeNickname(const ClientRef &ref, const std::string &folded, const std::string &nickname, const std::string &previous) {
+    if (nickname != previous)
+    {
+        // A change of case only: the entry is released and claimed again, as for any rename
+        if (ircLower(previous) == folded)
+            forgetSuffix(folded);
+        nicknames[folded] = ref;
+    }
+    runOn(ref.shard, [ref, nickname](Server &home) {
+        home.nicknameResolved(ref, nickname);
+    });
+}
 
-        if (finalNickname != oldNickname) {
-            std::string response = ":" + oldNickname + "!" + it->getUsername() + 
-                "@" + hostname + " NICK :" + finalNickname + "\r\n";
-            sendToClient(clientFd, response);
-
-            for (const std::string &channelName : it->getJoinedChannels()) {
-                Channel *channel = getChannel(channelName);
-                if (channel) {
-                    for (int memberFd : channel->getMembers()) {
-                        if (memberFd != clientFd) {
-                            sendToClient(memberFd, response);
-                        }
-                    }
-                }
-            }
+void Server::nicknameResolved(const ClientRef &ref, const std::string &nickname) {
+    Connection *connection = connectionOf(ref);
+    if (!connection || connection->client.isDetached())
+    {
+        // Gone while its claim was on the way, the nickname goes back
+        std::string folded = ircLower(nickname);
+        runOn(ownerOf(folded), [ref, folded](Server &owner) {
+            owner.releaseNickname(ref, folded);
+        });
+        return;
+    }
 
-            it->setNickname(finalNickname);
-            std::cout << "Client " << clientFd << " changed nickname from " << oldNickname << " to " << finalNickname << std::endl;
-        } else {
-            std::string errorResponse = "433 " + finalNickname + " :Nickname is already in use\r\n";
-            sendToClient(clientFd, errorResponse);
-        }
-    } else {
-        std::cerr << "Client " << clientFd << " not found" << std::endl;
+    int clientFd = ref.fd;
+    Client &client = connection->client;
+    std::string oldNickname = client.getNickname();
+    if (nickname == oldNickname)
+    {
+        sendReply(clientFd, numeric(clientFd, "433") << ' ' << nickname << " :Nickname is already in use");
+        finish(ref);
+        return;
+    }
+
+    SharedMessage response = (Reply(client.getPrefix(), "NICK") << " :" << nickname).share();
+    sendToClient(clientFd, response);
+    if (!ircEquals(oldNickname, nickname))
+        releaseNickname(client);
+    client.setNickname(nickname);
+    LOG_INFO("Client " << clientFd << " changed nickname from " << oldNickname << " to " << nickname);
+
+    reachNeighbours(clientFd, response, false, [ref](Server &home) {
+        if (home.connectionOf(ref))
+            home.maybeWelcome(ref.fd);
+        home.finish(ref);
+    });
+}
+
+// Hands the client's nickname back to the shard that owns it
+void Server::releaseNickname(const Client &client) {
+    if (client.getNickname().empty())
+        return;
+
+    ClientRef ref = refOf(client.getClientFd());
+    std::string folded = ircLower(client.getNickname());
+    runOn(ownerOf(folded), [ref, folded](Server &owner) {
+        owner.releaseNickname(ref, folded);
+    });
+}
+
+void Server::releaseNickname(const ClientRef &ref, const std::string &folded) {
+    auto it = nicknames.find(folded);
+    if (it != nicknames.end() && it->second == ref)
+    {
+        nicknames.erase(it);
+        forgetSuffix(folded);
     }
 }
 
+// A freed suffix lowers its base's hint so the next collision reuses it
+void Server::forgetSuffix(const std::string &folded) {
+    nickSuffixHint.erase(folded);
+    auto suffixed = suffixedNicks.find(folded);
+    if (suffixed == suffixedNicks.end())
+        return;
+
+    NickSuffix freed = suffixed->second;
+    suffixedNicks.erase(suffixed);
+    runOn(ownerOf(freed.base), [freed](Server &base) {
+        base.lowerSuffixHint(freed);
+    });
+}
+
+void Server::lowerSuffixHint(const NickSuffix &freed) {
+    auto hint = nickSuffixHint.find(freed.base);
+    if (hint != nickSuffixHint.end() && hint->second >= freed.suffix)
+        hint->second = freed.suffix - 1;
+}
+
 void Server::sendToClient(int clientFd, const std::string &message) {
-    send(clientFd, message.c_str(), message.size(), 0);
+    sendToClient(clientFd, std::make_shared<const std::string>(message));
+}
+
+void Server::sendToClient(int clientFd, const SharedMessage &message) {
+    Connection *connection = connections.get(clientFd);
+    if (!connection)
+        return;
+
+    if (!queueOutput(clientFd, connection->output, message))
+        return;
+
+    LOG_TRAFFIC("Sent to client " << clientFd << " >>> " << *message);
+}
+
+// A client of another shard gets the message after everything this shard sent it before
+void Server::sendToClient(const ClientRef &ref, const SharedMessage &message) {
+    if (ref.shard != shardIndex)
+    {
+        post(ref.shard, [ref, message](Server &home) {
+            home.sendToClient(ref, message);
+        });
+        return;
+    }
+
+    Connection *connection = connectionOf(ref);
+    if (!connection || !queueOutput(ref.fd, connection->output, message))
+        return;
+
+    LOG_TRAFFIC("Sent to client " << ref.fd << " >>> " << *message);
+}
+
+// Formatted straight into the client's output queue, no per-reply allocation
+void Server::sendReply(int clientFd, const Reply &reply) {
+    Connection *connection = connections.get(clientFd);
+    if (!connection)
+        return;
+
+    if (!queueOutput(clientFd, connection->output, reply.line()))
+        return;
+
+    LOG_TRAFFIC("Sent to client " << clientFd << " >>> " << reply.line());
+}
+
+void Server::sendReply(const ClientRef &ref, const Reply &reply) {
+    if (ref.shard != shardIndex)
+    {
+        sendToClient(ref, reply.share());
+        return;
+    }
+
+    Connection *connection = connectionOf(ref);
+    if (!connection || !queueOutput(ref.fd, connection->output, reply.line()))
+        return;
+
+    LOG_TRAFFIC("Sent to client " << ref.fd << " >>> " << reply.line());
+}
+
+// Numerics are addressed to the client's nickname, or "*" before it has one
+Reply Server::numeric(int clientFd, const char *code) {
+    Client *client = getClient(clientFd);
+    StringView target = (client && !client->getNicknameView().empty()) ? client->getNicknameView() : StringView("*");
+    return (Reply(hostname, code, target));
+}
+
+Reply Server::numeric(const ClientCard &card, const char *code) {
+    StringView target = card.nickname.empty() ? StringView("*") : StringView(card.nickname);
+    return (Reply(hostname, code, target));
+}
+
+bool Server::queueOutput(int clientFd, ClientOutput &output, const SharedMessage &message) {
+    if (output.closing)
+        return (false);
+
+    output.queue.append(message);
+    return (scheduleOutput(clientFd, output));
+}
+
+bool Server::queueOutput(int clientFd, ClientOutput &output, const StringView &line) {
+    if (output.closing)
+        return (false);
+
+    output.queue.append(line.data(), line.size());
+    return (scheduleOutput(clientFd, output));
+}
+
+bool Server::scheduleOutput(int clientFd, ClientOutput &output) {
+    if (!output.scheduled)
+    {
+        output.scheduled = true;
+        pendingFlush.push_back(connections.handle(clientFd));
+    }
+
+    // A reader that keeps up only looks behind until the end of the tick, drain it now if the socket allows
+    if (output.queue.size() > config.sendqSoft && !reactor->asyncWrites() && !flushClient(clientFd))
+    {
+        closeSendQExceeded(clientFd, output);
+        return (false);
+    }
+    if (output.queue.size() > config.sendqHard)
+    {
+        closeSendQExceeded(clientFd, output);
+        return (false);
+    }
+    if (output.queue.size() > config.sendqSoft)
+    {
+        time_t now = time(NULL);
+        if (!output.behindSince)
+            output.behindSince = now;
+        else if (now - output.behindSince >= config.sendqGrace)
+        {
+            closeSendQExceeded(clientFd, output);
+            return (false);
+        }
+    }
+    return (true);
+}
 
-    auto now = std::chrono::system_clock::now();
-    std::time_t now_time = std::chrono::system_clock::to_time_t(now);
-    std::tm *now_tm = std::localtime(&now_time);
+// Removal is deferred to the end of the tick so broadcast loops never see membership change under them
+void Server::closeSendQExceeded(int clientFd, ClientOutput &output) {
+    LOG_WARN("Client " << clientFd << " SendQ exceeded (" << output.queue.size() << " bytes queued)");
+    closeLink(clientFd, output, "SendQ exceeded");
+}
+
+// What is already on its way to the peer is finished, the rest is replaced by the ERROR line.
+// The connection goes once that is written, or after sendqGrace for a peer that stopped reading
+void Server::closeLink(int clientFd, ClientOutput &output, const std::string &reason) {
+    output.queue.truncate(output.inFlight);
+    output.queue.append(std::make_shared<const std::string>("ERROR :Closing Link: " + hostname + " (" + reason + ")\r\n"));
+    output.closing = true;
+    output.closingSince = time(NULL);
+    pendingClose.push_back(connections.handle(clientFd));
+}
 
-    std::ostringstream time_stream;
-    time_stream << std::put_time(now_tm, "%Y-%m-%d %H:%M:%S");
-    std::cout << time_stream.str() << " ******************** Sent to client " << clientFd << " >>> " << message << std::endl;
+void Server::broadcastToChannel(const Channel &channel, const std::string &message, int exceptFd) {
+    broadcastToChannel(channel, std::make_shared<const std::string>(message), exceptFd);
+}
+
+// Members on this shard are queued right away, those on each other shard get one task carrying them all
+void Server::broadcastToChannel(const Channel &channel, const SharedMessage &message, int exceptFd) {
+    size_t recipients = 0;
+
+    for (const Membership &member : channel.getMembers())
+    {
+        if (member.ref.fd == exceptFd)
+            continue;
+        if (member.ref.shard != shardIndex)
+        {
+            outgoing[member.ref.shard].push_back(member.ref);
+            recipients++;
+            continue;
+        }
+        Connection *connection = connectionOf(member.ref);
+        if (!connection)
+            continue;
+
+        if (queueOutput(member.ref.fd, connection->output, message))
+            recipients++;
+    }
+    sendOutgoing(message);
+
+    LOG_TRAFFIC("Sent to " << channel.getName() << " (" << recipients << " members) >>> " << *message);
 }
 
 void Server::handleCapLs(int clientFd) {
-    std::string capList = "multi-prefix sasl";
-    std::string response = "CAP * LS :" + capList + "\r\n";
-    sendToClient(clientFd, response); 
+    sendReply(clientFd, Reply(hostname, "CAP", "*") << " LS :multi-prefix sasl");
 }
 
 void Server::handleCapReq(int clientFd, const std::vector<std::string> &capabilities) {
-    auto it = std::find_if(clients.begin(), clients.end(), [clientFd](const Client &client) {
-        return client.getClientFd() == clientFd;
-    });
+    Client *client = getClient(clientFd);
 
-    if (it != clients.end()) {
+    if (client) {
         for (const auto &cap : capabilities) {
-            it->addCapability(cap);
+            client->addCapability(cap);
         }
-        std::string response = "CAP * ACK :" + capabilities[0] + "\r\n";
-        sendToClient(clientFd, response); 
+        sendReply(clientFd, Reply(hostname, "CAP", "*") << " ACK :" << capabilities[0]);
     }
 }
 
 void Server::handleCapEnd(int clientFd) {
-    auto it = std::find_if(clients.begin(), clients.end(), [clientFd](const Client &client) {
-        return client.getClientFd() == clientFd;
-    });
+    Client *client = getClient(clientFd);
 
-    if (it != clients.end()) {
-        it->setCapNegotiation(false);
-        std::cout << "CAP negotiation ended for client " << clientFd << std::endl;
+    if (client) {
+        client->setCapNegotiation(false);
+        LOG_INFO("CAP negotiation ended for client " << clientFd);
     }
 }
 
+// Channel commands run on the shard that owns the channel, the client's own shard only learns the outcome
 void Server::handleJoinCommand(int clientFd, const std::string &channelName, const std::string &providedKey)
 {
-    Client *client = getClient(clientFd);
+    beginOp(clientFd);
+    SharedCard actor = cardOf(clientFd);
+    runOn(ownerOf(channelName), [actor, channelName, providedKey](Server &owner) {
+        owner.joinChannel(actor, channelName, providedKey);
+        owner.finish(actor->ref);
+    });
+}
 
+void Server::joinChannel(const SharedCard &actor, const std::string &channelName, const std::string &providedKey)
+{
+    int clientFd = actor->ref.fd;
     Channel *channel = getChannel(channelName);
+    unsigned char memberFlags = 0;
     if (!channel)
     {
-        auto result = channels.emplace(channelName, Channel(channelName));
-        channel = &result.first->second;
+        channel = channels.create(channelName);
+        memberFlags = MEMBER_OP;
 
-        channel->addOperator(clientFd);
-        std::cout << "Channel " << channelName << " created and client " << clientFd << " set as operator" << std::endl;
+        LOG_INFO("Channel " << channelName << " created and client " << clientFd << " set as operator");
     }
     else
     {
-        if (channel->isInviteOnly() && !channel->isInvited(clientFd))
+        if (channel->isInviteOnly() && !channel->isInvited(actor->ref))
         {
-            std::cerr << "Client " << clientFd << " attempted to join invite-only channel " << channelName << " without an invitation" << std::endl;
-            std::string response = "473 " + client->getNickname() + " " + channelName + " :Cannot join channel (+i)\r\n";
-            sendToClient(clientFd, response);
+            LOG_WARN("Client " << clientFd << " attempted to join invite-only channel " << channelName << " without an invitation");
+            sendReply(actor->ref, numeric(*actor, "473") << ' ' << channelName << " :Cannot join channel (+i)");
             return;
         }
         if (channel->hasKey())
         {
             if (providedKey != channel->getKey())
             {
-                std::cerr << "Client " << clientFd << " provided an incorrect password for channel " << channelName << std::endl;
-                std::string response = "475 " + client->getNickname() + " " +  channelName + " :Cannot join channel (+k) - bad key\r\n"; 
-                sendToClient(clientFd, response);
+                LOG_WARN("Client " << clientFd << " provided an incorrect password for channel " << channelName);
+                sendReply(actor->ref, numeric(*actor, "475") << ' ' << channelName << " :Cannot join channel (+k) - bad key");
                 return;
             }
         }
-        if (channel->isMember(clientFd))
+        if (channel->isMember(actor->ref))
         {
-            std::cerr << "Client " << clientFd << " is already in channel " << channelName << std::endl;
+            LOG_WARN("Client " << clientFd << " is already in channel " << channelName);
             return;
         }
         if (channel->userLimitReached())
         {
-            std::cerr << "Client " << clientFd << " attempted to join channel " << channelName << " but it is full" << std::endl;
-            std::string response = "471 " + client->getNickname() + " " + channelName + " :Cannot join channel (+l)\r\n"; 
-            sendToClient(clientFd, response);
+            LOG_WARN("Client " << clientFd << " attempted to join channel " << channelName << " but it is full");
+            sendReply(actor->ref, numeric(*actor, "471") << ' ' << channelName << " :Cannot join channel (+l)");
             return;
         }
     }
 
-    channel->addMember(clientFd);
-    client->joinChannel(channelName);
-    std::cout << "Added client " << clientFd << " to channel " << channelName << std::endl;
+    channel->addMember(actor, memberFlags);
+    ClientRef ref = actor->ref;
+    std::string joined = channel->getName();
+    runOn(ref.shard, [ref, joined](Server &home) {
+        home.joinedChannel(ref, joined);
+    });
+    LOG_INFO("Added client " << clientFd << " to channel " << channelName);
 
-    std::string response = ":" + client->getNickname() + "!" + 
-        client->getUsername() + "@" + hostname + " JOIN " + channelName + "\r\n";
-    sendToClient(clientFd, response);
+    broadcastToChannel(*channel, (Reply(actor->prefix, "JOIN", channelName)).share());
 
-    for (int memberFd : channel->getMembers())
-    {
-        if (memberFd != clientFd)
-            sendToClient(memberFd, response);
-    }
-
-    std::cout << "Client " << clientFd << " joined channel " << channelName << std::endl;
+    LOG_INFO("Client " << clientFd << " joined channel " << channelName);
 }
 
 void Server::handleUserCommand(int clientFd, const std::string &username, const std::string &hostname, const std::string &servername, const std::string &realname) {
     (void)hostname;
     (void)servername;
 
-    auto it = std::find_if(clients.begin(), clients.end(), [clientFd](const Client &client) {
-        return client.getClientFd() == clientFd;
-    });
+    Client *client = getClient(clientFd);
 
-    if (it != clients.end()) {
-        it->setUsername(username);
-        it->setRealname(realname);
-        std::cout << "Client " << clientFd << " set username to " << username << " and realname to " << realname << std::endl;
+    if (client) {
+        client->setUsername(username);
+        client->setRealname(realname);
+        publishCard(clientFd);
+        LOG_INFO("Client " << clientFd << " set username to " << username << " and realname to " << realname);
     } else {
-        std::cerr << "Client " << clientFd << " not found" << std::endl;
+        LOG_WARN("Client " << clientFd << " not found");
     }
 }
 
 void Server::handlePassCommand(int clientFd, const std::string &password)
 {
-    auto it = std::find_if(clients.begin(), clients.end(), [clientFd](const Client &client) {
-        return client.getClientFd() == clientFd;
-    });
+    Client *client = getClient(clientFd);
 
-    if (it != clients.end())
+    if (client)
     {
         if (password == this->password)
         {
-            it->setAuthenticated(true);
-            std::cout << "Client " << clientFd << " authenticated successfully" << std::endl;
+            client->setAuthenticated(true);
+            LOG_INFO("Client " << clientFd << " authenticated successfully");
         }
         else
         {
-            std::cerr << "Client " << clientFd << " provided incorrect password" << std::endl;
-            std::string response = "464 :Password incorrect\r\n";
-            sendToClient(clientFd, response);
+            LOG_WARN("Client " << clientFd << " provided incorrect password");
+            sendReply(clientFd, numeric(clientFd, "464") << " :Password incorrect");
             removeClient(clientFd);
         }
     }
     else
     {
-        std::cerr << "Client " << clientFd << " not found" << std::endl;
+        LOG_WARN("Client " << clientFd << " not found");
     }
 }
 
 void Server::handlePartCommand(int clientFd, const std::string &channelName, const cmd_syntax &parsed)
 {
     (void) parsed;
+    beginOp(clientFd);
+    SharedCard actor = cardOf(clientFd);
+    runOn(ownerOf(channelName), [actor, channelName](Server &owner) {
+        owner.partChannel(actor, channelName);
+        owner.finish(actor->ref);
+    });
+}
+
+void Server::partChannel(const SharedCard &actor, const std::string &channelName)
+{
+    int clientFd = actor->ref.fd;
     Channel *channel = getChannel(channelName);
     if (!channel) {
-        std::cerr << "Channel " << channelName << " does not exist" << std::endl;
-        std::string response = "403 " + channelName + " :No such channel\r\n"; 
-        sendToClient(clientFd, response);
+        LOG_WARN("Channel " << channelName << " does not exist");
+        sendReply(actor->ref, numeric(*actor, "403") << ' ' << channelName << " :No such channel");
         return;
     }
 
-    if (!channel->isMember(clientFd)) {
-        std::cerr << "Client " << clientFd << " is not in channel " << channelName << std::endl;
-        std::string response = "442 " + channelName + " :You're not on that channel\r\n";
-        sendToClient(clientFd, response);
+    if (!channel->isMember(actor->ref)) {
+        LOG_WARN("Client " << clientFd << " is not in channel " << channelName);
+        sendReply(actor->ref, numeric(*actor, "442") << ' ' << channelName << " :You're not on that channel");
         return;
     }
 
-    channel->removeMember(clientFd);
+    channel->removeMember(actor->ref);
 
-    getClient(clientFd)->leaveChannel(channelName);
+    ClientRef ref = actor->ref;
+    std::string left = channel->getName();
+    runOn(ref.shard, [ref, left](Server &home) {
+        home.leftChannel(ref, left);
+    });
 
-    std::cout << "Client " << clientFd << " left channel " << channelName << std::endl;
+    LOG_INFO("Client " << clientFd << " left channel " << channelName);
 
-    std::string response = ":" + getClient(clientFd)->getNickname() + "!" + 
-        getClient(clientFd)->getUsername() + "@" + hostname + " PART " + channelName + "\r\n";
-    sendToClient(clientFd, response);
-
-    for (int memberFd : channel->getMembers()) {
-        sendToClient(memberFd, response);
-    }
+    SharedMessage response = Reply(actor->prefix, "PART", channelName).share();
+    sendToClient(ref, response);
+    broadcastToChannel(*channel, response);
 
     if (channel->getMembers().empty()) {
-        channels.erase(channelName);
-        std::cout << "Channel " << channelName << " is now empty and has been removed" << std::endl;
+        LOG_INFO("Channel " << channel->getName() << " is now empty and has been removed");
+        channels.destroy(*channel);
     }
 }
 
+// Channel messages go through the channel's shard, private ones through the shard owning the nickname
 void Server::handlePrivmsgCommand(int clientFd, const std::string &target, const std::string &message) {
     Client *client = getClient(clientFd);
     if (!client) {
-        std::cerr << "Client " << clientFd << " not found" << std::endl;
+        LOG_WARN("Client " << clientFd << " not found");
         return;
     }
 
-    std::string sender = client->getNickname();
+    beginOp(clientFd);
+    SharedCard actor = cardOf(clientFd);
+    bool toChannel = (target[0] == '#');
+    runOn(ownerOf(target), [actor, target, message, toChannel](Server &owner) {
+        if (toChannel)
+            owner.messageChannel(actor, target, message);
+        else
+            owner.messageNickname(actor, target, message);
+        owner.finish(actor->ref);
+    });
+}
 
-    if (target[0] == '#') {
-        Channel *channel = getChannel(target);
-        if (!channel) {
-            std::cerr << "Channel " << target << " does not exist" << std::endl;
-            std::string response = "403 " + target + " :No such channel\r\n";
-            sendToClient(clientFd, response);
-            return;
-        }
+void Server::messageChannel(const SharedCard &actor, const std::string &target, const std::string &message) {
+    Channel *channel = getChannel(target);
+    if (!channel) {
+        LOG_WARN("Channel " << target << " does not exist");
+        sendReply(actor->ref, numeric(*actor, "403") << ' ' << target << " :No such channel");
+        return;
+    }
 
-        if (!channel->isMember(clientFd)) {
-            std::cerr << "Client " << clientFd << " is not a member of channel " << target << std::endl;
-            std::string response = "442 " + target + " :You're not on that channel\r\n";
-            sendToClient(clientFd, response);
-            return;
-        }
+    if (!channel->isMember(actor->ref)) {
+        LOG_WARN("Client " << actor->ref.fd << " is not a member of channel " << target);
+        sendReply(actor->ref, numeric(*actor, "442") << ' ' << target << " :You're not on that channel");
+        return;
+    }
 
-        std::string response = ":" + sender + " PRIVMSG " + target + " :" + message + "\r\n";
-        for (int memberFd : channel->getMembers()) {
-            if (memberFd != clientFd) {
-                sendToClient(memberFd, response);
-            }
-        }
-    } else {
-        Client *targetClient = getClientByNickname(target);
-        if (!targetClient) {
-            std::cerr << "User " << target << " does not exist" << std::endl;
-            std::string response = "401 " + target + " :No such nick/channel\r\n";
-            sendToClient(clientFd, response);
-            return;
-        }
+    broadcastToChannel(*channel, (Reply(actor->prefix, "PRIVMSG", target) << " :" << message).share(), actor->ref.fd);
+}
 
-        int targetFd = targetClient->getClientFd();
-        std::string response = ":" + sender + "!" + client->getUsername() + 
-            "@" + hostname + " PRIVMSG " + target + " :" + message + "\r\n";
-        sendToClient(targetFd, response);
+void Server::messageNickname(const SharedCard &actor, const std::string &target, const std::string &message) {
+    ClientRef targetRef;
+    if (!findNickname(target, targetRef)) {
+        LOG_WARN("User " << target << " does not exist");
+        sendReply(actor->ref, numeric(*actor, "401") << ' ' << target << " :No such nick/channel");
+        return;
     }
+
+    sendReply(targetRef, Reply(actor->prefix, "PRIVMSG", target) << " :" << message);
 }
 
 void Server::handleHelpCommand(int clientFd) {
-    std::string response =
-    "375 :- INFO Command List -\r\n"
-    "372 :- NICK nickname - Set your nickname\r\n"
-    "372 :- USER username hostname servername :realname - Register your username\r\n"
-    "372 :- JOIN #channel - Join a channel\r\n"
-    "372 :- PART #channel - Leave a channel\r\n"
-    "372 :- PRIVMSG target message - Send a private message to a user or channel\r\n"
-    "372 :- MODE #channel mode - Set channel modes\r\n"
-    "372 :- TOPIC #channel topic - Set the topic for a channel\r\n"
-    "372 :- KICK #channel target - Kick a user from a channel\r\n"
-    "372 :- INVITE target #channel - Invite a user to a channel\r\n"
-    "372 :- QUIT message - Disconnect from the server\r\n"
-    "372 :- INFO - Show this help message\r\n"
-    "376 :- End of INFO list\r\n";
-
-
-    sendToClient(clientFd, response);
+    sendToClient(clientFd, infoText);
 }
 
+// Without a target every shard lists its own clients, the parts are sent in shard order as one reply
 void Server::handleWhoCommand(int clientFd, const std::string &target)
 {
-    std::ostringstream response;
+    beginOp(clientFd);
+    SharedCard actor = cardOf(clientFd);
 
     if (target.empty())
     {
-        for (const Client &client : clients) {
-            response << client.getNickname() << " "
-                     << client.getUsername() << " "
-                     << client.getRealname() << "\r\n";
-        }
+        std::vector<unsigned> shards;
+        for (unsigned shard = 0; shard < config.shards; shard++)
+            shards.push_back(shard);
+        gather<std::string>(shards, [](Server &shard, size_t) {
+            return (shard.listClients());
+        }, [actor](Server &home, std::vector<std::string> &parts) {
+            std::string response;
+            for (const std::string &part : parts)
+                response += part;
+            home.sendToClient(actor->ref, std::make_shared<const std::string>(response));
+            home.finish(actor->ref);
+        });
     }
-    else if (target[0] == '#')
+    else
     {
-        Channel *channel = getChannel(target);
-        if (!channel)
-        {
-            std::cerr << "Channel " << target << " does not exist" << std::endl;
-            std::string errorResponse = "403 " + target + " :No such channel\r\n";
-            sendToClient(clientFd, errorResponse);
-            return;
-        }
-
-        for (int memberFd : channel->getMembers())
-        {
-            Client *member = getClient(memberFd);
-            if (member)
+        bool channel = (target[0] == '#');
+        runOn(ownerOf(target), [actor, target, channel](Server &owner) {
+            if (channel)
             {
-                response << member->getNickname() << " " << member->getUsername() << 
-                    "@" << hostname << " " << member->getRealname() << "\r\n";
+                owner.listChannel(actor, target);
+                owner.finish(actor->ref);
             }
-        }
+            else
+                owner.listNickname(actor, target);
+        });
     }
-    else
-    {
-        Client *targetClient = getClientByNickname(target);
-        if (!targetClient)
-        {
-            std::cerr << "User " << target << " does not exist" << std::endl;
-            std::string errorResponse = "401 " + target + " :No such nick/channel\r\n";
-            sendToClient(clientFd, errorResponse);
-            return;
-        }
+}
 
-        response << targetClient->getNickname() << " "
-                 << targetClient->getUsername() << " "
-                 << targetClient->getRealname() << "\r\n";
+std::string Server::listClients()
+{
+    std::ostringstream response;
+    for (int fd : connections.fds()) {
+        const Client &client = connections.get(fd)->client;
+        response << client.getNickname() << " "
+                 << client.getUsername() << " "
+                 << client.getRealname() << "\r\n";
     }
-
-    sendToClient(clientFd, response.str());
+    return (response.str());
 }
 
-void Server::handleQuitCommand(int clientFd, const std::string &quitMessage)
+void Server::listChannel(const SharedCard &actor, const std::string &target)
 {
-    Client *client = getClient(clientFd);
-    if (!client)
-	{
-        std::cerr << "Client " << clientFd << " not found" << std::endl;
+    Channel *channel = getChannel(target);
+    if (!channel)
+    {
+        LOG_WARN("Channel " << target << " does not exist");
+        sendReply(actor->ref, numeric(*actor, "403") << ' ' << target << " :No such channel");
         return;
     }
 
-    std::string nickname = client->getNickname();
+    std::ostringstream response;
+    for (const SharedCard &card : channel->getCards())
+    {
+        const ClientCard &member = *card;
+        response << member.nickname << " " << member.username << 
+            "@" << hostname << " " << member.realname << "\r\n";
+    }
+    sendToClient(actor->ref, std::make_shared<const std::string>(response.str()));
+}
 
-    for (auto &channelPair : channels)
-	{
-        Channel &channel = channelPair.second;
-        if (channel.isMember(clientFd))
-		{
-            std::string response = ":" + nickname + "!" + client->getUsername() + 
-                "@" + hostname + " QUIT :" + quitMessage + "\r\n";
-            for (int memberFd : channel.getMembers())
-			{
-                if (memberFd != clientFd)
-                    sendToClient(memberFd, response);
-            }
-        }
+// On the shard owning the nickname; the client's own shard describes it
+void Server::listNickname(const SharedCard &actor, const std::string &target)
+{
+    ClientRef targetRef;
+    if (!findNickname(target, targetRef))
+    {
+        LOG_WARN("User " << target << " does not exist");
+        sendReply(actor->ref, numeric(*actor, "401") << ' ' << target << " :No such nick/channel");
+        finish(actor->ref);
+        return;
     }
 
-    for (auto it = channels.begin(); it != channels.end();)
-	{
-        Channel &channel = it->second;
-        channel.removeMember(clientFd);
+    runOn(targetRef.shard, [actor, target, targetRef](Server &home) {
+        home.describeClient(actor, target, targetRef);
+        home.finish(actor->ref);
+    });
+}
 
-        if (channel.getMembers().empty())
-            it = channels.erase(it);
-        else
-            ++it;
+void Server::describeClient(const SharedCard &actor, const std::string &target, const ClientRef &targetRef)
+{
+    Connection *connection = connectionOf(targetRef);
+    if (!connection)
+    {
+        LOG_WARN("User " << target << " does not exist");
+        sendReply(actor->ref, numeric(*actor, "401") << ' ' << target << " :No such nick/channel");
+        return;
     }
 
-    std::cout << "Client " << clientFd << " (" << nickname << ") disconnected with message: " << quitMessage << std::endl;
-    removeClient(clientFd);
+    const Client &targetClient = connection->client;
+    std::ostringstream response;
+    response << targetClient.getNickname() << " "
+             << targetClient.getUsername() << " "
+             << targetClient.getRealname() << "\r\n";
+    sendToClient(actor->ref, std::make_shared<const std::string>(response.str()));
 }
 
-void Server::sendWelcomeMessage(int clientFd, const Client &client) {
-    std::string asciiArt = R"(
-    
-██╗  ██╗ ██████╗ ██╗      █████╗ 
-██║  ██║██╔═══██╗██║     ██╔══██╗
-███████║██║   ██║██║     ███████║
-██╔══██║██║   ██║██║     ██╔══██║
-██║  ██║╚██████╔╝███████╗██║  ██║
-╚═╝  ╚═╝ ╚═════╝ ╚══════╝╚═╝  ╚═╝
+// The channels' shards drop the client and name its neighbours, the connection goes once all have answered
+void Server::handleQuitCommand(int clientFd, const std::string &quitMessage)
+{
+    Client *client = getClient(clientFd);
+    if (!client)
+	{
+        LOG_WARN("Client " << clientFd << " not found");
+        return;
+    }
 
-NOTICE: THIS SERVER MANAGES UP TO 1000 CLIENTS! 
+    std::string nickname = client->getNickname();
 
-Type /JOIN channel_name to create/join a channel
-or '/INFO' for a list of commands ('INFO' from netcat)
+    beginOp(clientFd);
+    ClientRef ref = refOf(clientFd);
+    SharedMessage response = (Reply(client->getPrefix(), "QUIT") << " :" << quitMessage).share();
+    reachNeighbours(clientFd, response, true, [ref](Server &home) {
+        if (home.connectionOf(ref))
+            home.removeClient(ref.fd);
+    });
 
-    )";
-    
-    std::string welcomeMessage = "001 " + client.getNickname() + " :Welcome to the Internet Relay Network " + client.getNickname() + "!" + client.getUsername() + "@localhost\n\n";
+    LOG_INFO("Client " << clientFd << " (" << nickname << ") disconnected with message: " << quitMessage);
+}
 
-            sendToClient(clientFd, welcomeMessage + asciiArt + "\r\n");
+void Server::sendWelcomeMessage(int clientFd, const Client &client) {
+    sendReply(clientFd, numeric(clientFd, "001") << " :Welcome to the Internet Relay Network " << client.getPrefix());
+    sendToClient(clientFd, welcomeBanner);
+    sendReply(clientFd, numeric(clientFd, "005") << " CASEMAPPING=rfc1459 CHANTYPES=# PREFIX=(ov)@+ CHANMODES=,k,l,it MODES=" << MAX_MODES
+        << " NICKLEN=" << NICKLEN << " USERLEN=" << USERLEN << " :are supported by this server");
 
-    std::cout << "Sent welcome message to client " << clientFd << std::endl;
+    LOG_INFO("Sent welcome message to client " << clientFd);
 }
@@ -32,30 +32,110 @@
 # include "Client.hpp"
 # include "Channel.hpp"
 # include "Parsing.hpp"
+# include "Reactor.hpp"
+# include "Mailbox.hpp"
+# include "OutputQueue.hpp"
+# include "ConnectionTable.hpp"
+# include "Log.hpp"
+# include "Config.hpp"
+# include "Casemap.hpp"
+# include "ChannelRegistry.hpp"
+# include "Reply.hpp"
+# include <memory>
+# include <atomic>
+# include <functional>
+# include <thread>
+# include <sys/resource.h>
+
+struct AcceptStats
+{
+	unsigned long	accepted;
+	unsigned long	rejected;
+	unsigned		backlog;
+	unsigned		queued;
+	unsigned		queuedPeak;
+	bool			sampleDue;
+
+	AcceptStats() : accepted(0), rejected(0), backlog(0), queued(0), queuedPeak(0), sampleDue(false) {}
+};
+
+// Which base nick a suffixed nick was resolved from, and with how many suffix characters
+struct NickSuffix
+{
+	std::string	base;
+	size_t		suffix;
+};
+
+class Server;
+
+// Work handed to another shard, run there with that shard's Server
+typedef std::function<void(Server &)>	ShardTask;
+
+// Route of a command that has to wait for every earlier command of its client
+# define ROUTE_ALONE		0xffu
+// What handleIncomingMessage returns for a line that has to wait, see processLines
+# define LINE_DEFERRED		static_cast<unsigned>(-1)
+// Tasks from other shards run per tick before the shard's own clients get their turn again
+# define SHARD_TASK_BATCH	1024
+
+// Every shard is a full Server on its own thread; this is what they share
+struct ShardGroup
+{
+	std::vector<Server *>	servers;
+	std::atomic<size_t>		clients;
+
+	ShardGroup() : clients(0) {}
+};
+
+// Answers for one command collected from several shards, see Server::gather
+template <typename T>
+struct Gather
+{
+	size_t												remaining;
+	std::vector<T>										answers;
+	std::function<void(Server &, std::vector<T> &)>	done;
+};
 
 class Server
 {
 	public:
 		const std::string DEFAULT_CHANNEL = "#default";
-		std::map<std::string, Channel> channels;
 
-		Server(int port, const std::string &password);
+		Server(int port, const std::string &password, const ServerConfig &config = ServerConfig());
 		~Server();
+		void raiseFileLimit();
 		void setupSocket();
+		int listenBacklog() const;
 		void handleConnections();
+		void sampleListenQueue();
+		void logAcceptStats() const;
+		void logBufferStats();
+		void acceptClient(int clientFd);
 		void handleClient(int clientFd);
+		bool handleClientData(int clientFd, const char *data, size_t length);
+		void reportOverflows(int clientFd, LineFramer &framer);
+		bool processLines(int clientFd, LineFramer &framer, size_t &budget);
 		void removeClient(int clientFd);
 		void closeServer();
-		void sendMessage();
-		void messageBuffer(int clientFd, const std::string &message);
+		bool flushClient(int clientFd);
+		void flushPendingOutput();
+		void handleWritten(int clientFd, size_t length);
 		void run();
 		void cleanExit();
-		void handleIncomingMessage(const std::string &message, int clientFd);
+		unsigned handleIncomingMessage(const StringView &message, int clientFd);
 		void handleNickCommand(int clientFd, const std::string &nickname);
 		void handleCapLs(int clientFd);
 		void handleCapReq(int clientFd, const std::vector<std::string> &capabilities);
 		void handleCapEnd(int clientFd);
 		void sendToClient(int clientFd, const std::string &message);
+		void sendToClient(int clientFd, const SharedMessage &message);
+		void sendToClient(const ClientRef &ref, const SharedMessage &message);
+		void sendReply(int clientFd, const Reply &reply);
+		void sendReply(const ClientRef &ref, const Reply &reply);
+		Reply numeric(int clientFd, const char *code);
+		Reply numeric(const ClientCard &card, const char *code);
+		void broadcastToChannel(const Channel &channel, const std::string &message, int exceptFd = -1);
+		void broadcastToChannel(const Channel &channel, const SharedMessage &message, int exceptFd = -1);
 		void handleJoinCommand(int clientFd, const std::string &channel, const std::string &providedKey);
 		void handlePartCommand(int clientFd, const std::string &channel, const cmd_syntax &parsed);
 		void handlePrivmsgCommand(int clientFd, const std::string &target, const std::string &message);
@@ -68,28 +148,168 @@ class Server
 		void handleKickCommand(int clientFd, const std::string &channel, const std::string &target, const std::string &reason);
 		void handleInviteCommand(int clientFd, const std::string &channel, const std::string &target);
 		void handleTopicCommand(int clientFd, const std::string &channel, const std::string &topic);		
-		void handleModeCommand(int clientFd, const std::string &channelName, char currentFlag, char modeChar, const std::string &parameter);		
+		void handleModeCommand(int clientFd, const std::string &channelName, const std::vector<ModeChange> &changes);		
 		void sendWelcomeMessage(int clientFd, const Client &client);
 
 		Channel	*getChannel(const std::string &channelName);
 		Client	*getClient(int clientFd);
-		Client	*getClientByNickname(const std::string &nickname);
 		const std::string &getHostname() const { return hostname; }
+		unsigned ownerOf(const StringView &name) const;
 		
 	private:
 		int port;
 		std::string 							password;
 		int 									serverSocket;
-		bool 									running;
+		std::atomic<bool>						running;
 		struct sockaddr_in 						serverAddress;
-		std::vector<struct pollfd> 				pollfds;
-		std::unordered_map<int, std::string> 	clientBuffer;
-		std::vector<Client> 					clients;
+		ServerConfig							config;
+		std::unique_ptr<Reactor>				reactor;
+		ConnectionTable							connections;
+		ChannelRegistry							channels;
+		unsigned								fanoutEpoch;
+		std::unordered_map<std::string, ClientRef>	nicknames;
+		std::unordered_map<std::string, size_t>	nickSuffixHint;
+		std::unordered_map<std::string, NickSuffix>	suffixedNicks;
+		std::vector<ClientHandle>				pendingFlush;
+		std::vector<ClientHandle>				pendingClose;
+		std::vector<ClientHandle>				throttled;
+		std::vector<ClientHandle>				runQueue;
+		std::vector<char>						recvScratch;
 		std::string 							hostname;
-		
+		AcceptStats								acceptStats;
+		bool									acceptPending;
+		std::vector<int>						acceptedQueue;
+		time_t									lastBufferStats;
+		SharedMessage							welcomeBanner;
+		SharedMessage							infoText;
+		std::shared_ptr<ShardGroup>				group;
+		unsigned								shardIndex;
+		std::vector<std::unique_ptr<Server> >	peers;
+		std::vector<std::thread>				threads;
+		Mailbox<ShardTask>						inbox;
+		int										wakeFd;
+		std::vector<char>						wakeDue;
+		bool									inboxBacklog;
+		unsigned								dispatchRoute;
+		std::vector<std::vector<ClientRef> >	outgoing;
+
+		Server(int port, const std::string &password, const ServerConfig &config, const std::shared_ptr<ShardGroup> &group, unsigned shardIndex);
+		static void runShard(Server *server);
+		void setupWakeup();
+		void stopShards();
+		void drainInbox();
+		void wakePeers();
+		void post(unsigned shard, const ShardTask &task);
+		template <typename Task>
+		void runOn(unsigned shard, const Task &task);
+		template <typename T, typename Ask>
+		void gather(const std::vector<unsigned> &shards, const Ask &ask, const std::function<void(Server &, std::vector<T> &)> &done);
+		template <typename T>
+		void gathered(const std::shared_ptr<Gather<T> > &state);
+		void beginOp(int clientFd);
+		void finish(const ClientRef &ref);
+		void resume(const ClientRef &ref);
+		void maybeWelcome(int clientFd);
+		ClientRef refOf(int clientFd) const;
+		Connection *connectionOf(const ClientRef &ref) const;
+		const SharedCard &cardOf(int clientFd);
+		void deliver(const std::vector<ClientRef> &refs, const SharedMessage &message);
+		void sendOutgoing(const SharedMessage &message);
+
 		void retrieveHostname();
+		bool findNickname(const std::string &nickname, ClientRef &ref) const;
+		std::vector<std::string> knownNicknames(const std::vector<std::string> &nicknames) const;
+		void claimNickname(const ClientRef &ref, const std::string &nickname, const std::string &previous);
+		void retryNickname(const ClientRef &ref, const std::string &nickname, const std::string &previous);
+		void probeNickname(const ClientRef &ref, const std::string &nickname, const std::string &candidate, size_t hint, const std::string &previous);
+		void takeNickname(const ClientRef &ref, const std::string &folded, const std::string &nickname, const std::string &previous);
+		void nicknameResolved(const ClientRef &ref, const std::string &nickname);
+		void releaseNickname(const Client &client);
+		void releaseNickname(const ClientRef &ref, const std::string &folded);
+		void forgetSuffix(const std::string &folded);
+		void lowerSuffixHint(const NickSuffix &freed);
+		void reachNeighbours(int clientFd, const SharedMessage &message, bool leaving, const ShardTask &done);
+		std::vector<ClientRef> collectNeighbours(const SharedCard &card, const std::vector<std::string> &channelNames, bool leaving);
+		void deliverOnce(std::vector<std::vector<ClientRef> > &answers, const ClientRef &self, const SharedMessage &message);
+		void channelsByOwner(const Client &client, std::vector<unsigned> &shards, std::vector<std::vector<std::string> > &channelNames) const;
+		void publishCard(int clientFd);
+		void updateCards(const SharedCard &card, const std::vector<std::string> &channelNames);
+		void detachClient(Client &client);
+		void leaveAllChannels(Client &client);
+		void forgetInvites(Client &client);
+		void leaveChannel(const ClientRef &ref, const std::string &channelName);
+		void joinedChannel(const ClientRef &ref, const std::string &channelName);
+		void leftChannel(const ClientRef &ref, const std::string &channelName);
+		void invitedTo(const ClientRef &ref, const std::string &channelName, const SharedMessage &message);
+		void uninvite(const ClientRef &ref, const std::string &channelName);
+		void joinChannel(const SharedCard &actor, const std::string &channelName, const std::string &providedKey);
+		void partChannel(const SharedCard &actor, const std::string &channelName);
+		void messageChannel(const SharedCard &actor, const std::string &channelName, const std::string &message);
+		void messageNickname(const SharedCard &actor, const std::string &nickname, const std::string &message);
+		void listChannel(const SharedCard &actor, const std::string &channelName);
+		void listNickname(const SharedCard &actor, const std::string &nickname);
+		void describeClient(const SharedCard &actor, const std::string &nickname, const ClientRef &target);
+		std::string listClients();
+		void changeTopic(const SharedCard &actor, const std::string &channelName, const std::string &topic);
+		bool kickMember(const SharedCard &actor, const std::string &channelName, const std::string &target, const std::string &reason);
+		void replyNotOnChannel(const SharedCard &actor, const std::string &channelName, const std::string &target);
+		void inviteMember(const SharedCard &actor, const std::string &channelName, const std::string &target, const ClientRef &targetRef);
+		void changeModes(const SharedCard &actor, const std::string &channelName, const std::vector<ModeChange> &changes, const std::vector<std::string> &known);
+		bool applyModeChange(const ClientCard &actor, Channel &channel, const ModeChange &change, const std::vector<std::string> &known);
+		void announceModes(const ClientCard &actor, const Channel &channel, const std::string &modes, const std::string &parameters);
+		void serializeStaticReplies();
+		bool queueOutput(int clientFd, ClientOutput &output, const SharedMessage &message);
+		bool queueOutput(int clientFd, ClientOutput &output, const StringView &line);
+		bool scheduleOutput(int clientFd, ClientOutput &output);
+		void closeSendQExceeded(int clientFd, ClientOutput &output);
+		void closeLink(int clientFd, ClientOutput &output, const std::string &reason);
+		void refillFlood(FloodBucket &flood, long long now) const;
+		int resumeThrottled();
+		void queueRunnable(int clientFd, Connection &connection);
+		void serveRunQueue(std::vector<ClientHandle> &carried);
 };
 
+// Runs the task here when this shard is the one, otherwise it queues behind what was already sent there
+template <typename Task>
+void Server::runOn(unsigned shard, const Task &task)
+{
+	if (shard == shardIndex)
+		task(*this);
+	else
+		post(shard, ShardTask(task));
+}
+
+// Asks each shard one question; done runs here once every answer is back, answers in the order of shards.
+// The extra count keeps done from running before the last question was even sent
+template <typename T, typename Ask>
+void Server::gather(const std::vector<unsigned> &shards, const Ask &ask, const std::function<void(Server &, std::vector<T> &)> &done)
+{
+	std::shared_ptr<Gather<T> > state = std::make_shared<Gather<T> >();
+	state->remaining = shards.size() + 1;
+	state->answers.resize(shards.size());
+	state->done = done;
+
+	unsigned home = shardIndex;
+	for (size_t part = 0; part < shards.size(); part++)
+	{
+		runOn(shards[part], [state, ask, part, home](Server &shard) {
+			T answer = ask(shard, part);
+			shard.runOn(home, [state, part, answer](Server &asker) {
+				state->answers[part] = answer;
+				asker.gathered(state);
+			});
+		});
+	}
+	gathered(state);
+}
+
+template <typename T>
+void Server::gathered(const std::shared_ptr<Gather<T> > &state)
+{
+	if (--state->remaining == 0)
+		state->done(*this, state->answers);
+}
+
 extern Server *serverInstance;
 
 #endif
\ No newline at end of file
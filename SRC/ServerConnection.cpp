@@ -13,26 +13,79 @@
 #include "Server.hpp"
 #include "Parsing.hpp"
 #include "Commands.hpp"
+#include <fstream>
+#include <netinet/tcp.h>
+
+// The kernel clamps any larger backlog to net.core.somaxconn, so that is the useful maximum
+static int systemBacklog()
+{
+    std::ifstream file("/proc/sys/net/core/somaxconn");
+    int backlog = 0;
+    if (file >> backlog && backlog > 0)
+        return (backlog);
+    return (SOMAXCONN);
+}
+
+int Server::listenBacklog() const
+{
+    return (config.listenBacklog > 0 ? config.listenBacklog : systemBacklog());
+}
+
+// Every client is a descriptor, so the soft limit has to cover maxClients plus headroom
+void Server::raiseFileLimit()
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == -1)
+    {
+        LOG_WARN("Failed to read RLIMIT_NOFILE: " << strerror(errno));
+        return;
+    }
+
+    rlim_t wanted = config.maxClients + CONNECTION_FD_HEADROOM;
+    if (limit.rlim_cur >= wanted)
+        return;
+
+    struct rlimit raised = limit;
+    raised.rlim_cur = wanted;
+    if (raised.rlim_max < wanted)
+        raised.rlim_max = wanted;
+    if (setrlimit(RLIMIT_NOFILE, &raised) == -1)
+    {
+        raised.rlim_cur = limit.rlim_max;
+        raised.rlim_max = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &raised) == -1)
+            raised.rlim_cur = limit.rlim_cur;
+    }
+
+    if (raised.rlim_cur < wanted)
+    {
+        size_t fits = raised.rlim_cur > CONNECTION_FD_HEADROOM ? raised.rlim_cur - CONNECTION_FD_HEADROOM : 1;
+        LOG_WARN("RLIMIT_NOFILE is " << raised.rlim_cur << ", lowering max clients from " << config.maxClients << " to " << fits);
+        config.maxClients = fits;
+    }
+    else
+        LOG_INFO("Raised RLIMIT_NOFILE to " << raised.rlim_cur << " for " << config.maxClients << " clients");
+}
 
 void Server::setupSocket()
 {
-    serverSocket = socket(AF_INET, SOCK_STREAM, 0);
+    serverSocket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (serverSocket == -1)
     {
-        std::cerr << "Failed to create socket: " << strerror(errno) << std::endl;
+        LOG_ERROR("Failed to create socket: " << strerror(errno));
         exit(EXIT_FAILURE);
     }
 
-    if (fcntl(serverSocket, F_SETFL, O_NONBLOCK) == -1)
+    int opt = 1;
+    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1)
     {
-        std::cerr << "Failed to set server socket to non-blocking" << std::endl;
+        LOG_ERROR("Failed to set socket options");
         exit(EXIT_FAILURE);
     }
 
-    int opt = 1;
-    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1)
+    if (config.shards > 1 && setsockopt(serverSocket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1)
     {
-        std::cerr << "Failed to set socket options" << std::endl;
+        LOG_ERROR("Failed to set SO_REUSEPORT for sharded listeners");
         exit(EXIT_FAILURE);
     }
 
@@ -42,234 +95,674 @@ void Server::setupSocket()
 
     if (bind(serverSocket, (struct sockaddr *)&serverAddress, sizeof(serverAddress)) == -1)
     {
-        std::cerr << "Failed to bind socket" << std::endl;
+        LOG_ERROR("Failed to bind socket");
         exit(EXIT_FAILURE);
     }
 
-    if (listen(serverSocket, 10) == -1)
+    int backlog = listenBacklog();
+    if (listen(serverSocket, backlog) == -1)
     {
-        std::cerr << "Failed to listen on socket" << std::endl;
+        LOG_ERROR("Failed to listen on socket");
         exit(EXIT_FAILURE);
     }
+    acceptStats.backlog = backlog;
 
-    pollfds.push_back({serverSocket, POLLIN, 0});
-    std::cout << "Socket setup complete. Listening on port " << port << std::endl;
+    if (!reactor->addListener(serverSocket))
+    {
+        LOG_ERROR("Failed to register server socket with " << reactor->name());
+        exit(EXIT_FAILURE);
+    }
+    LOG_INFO("Socket setup complete. Listening on port " << port << " with a backlog of " << backlog);
 }
 
+// At most acceptBatch per tick; the listener is edge-triggered, so a capped batch
+// is resumed on the next tick instead of waiting for the next incoming connection.
+// Completion backends hand over connections already accepted, those queue up first.
 void Server::handleConnections()
 {
-    struct sockaddr_in clientAddress;
-    socklen_t clientLen = sizeof(clientAddress);
-    int clientFd;
+    size_t accepted = std::min(acceptedQueue.size(), config.acceptBatch);
+    for (size_t i = 0; i < accepted; i++)
+        acceptClient(acceptedQueue[i]);
+    acceptedQueue.erase(acceptedQueue.begin(), acceptedQueue.begin() + accepted);
+    if (!acceptPending)
+        return;
 
-    while ((clientFd = accept(serverSocket, (struct sockaddr *)&clientAddress, &clientLen)) >= 0)
+    acceptPending = false;
+    for (; accepted < config.acceptBatch; accepted++)
     {
-        if (clients.size() >= MAX_CLIENTS)
+        int clientFd = accept4(serverSocket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientFd >= 0)
         {
-            std::cerr << "Maximum number of clients reached. Rejecting connection from client " << clientFd << std::endl;
-            std::string response = "ERROR :Server full. Maximum number of clients reached.\r\n";
-            send(clientFd, response.c_str(), response.size(), 0);
-            close(clientFd);
+            acceptClient(clientFd);
             continue;
         }
-
-        if (fcntl(clientFd, F_SETFL, O_NONBLOCK) == -1)
-        {
-            std::cerr << "Failed to set client socket to non-blocking" << std::endl;
-            close(clientFd);
+        if (errno == EINTR || errno == ECONNABORTED)
             continue;
-        }
-
-        pollfds.push_back({clientFd, POLLIN, 0});
-        clients.emplace_back(clientFd); 
-        std::cout << "New client connected: " << clientFd << std::endl;
+        if (errno != EWOULDBLOCK && errno != EAGAIN)
+            LOG_ERROR("Failed to accept client connection: " << strerror(errno));
+        return;
     }
+    acceptPending = true;
+}
 
-    if (errno == EWOULDBLOCK || errno == EAGAIN)
+// For a listening socket TCP_INFO reports the accept queue length in tcpi_unacked
+void Server::sampleListenQueue()
+{
+    struct tcp_info info;
+    socklen_t length = sizeof(info);
+    acceptStats.sampleDue = false;
+    if (getsockopt(serverSocket, IPPROTO_TCP, TCP_INFO, &info, &length) == -1)
         return;
-    std::cerr << "Failed to accept client connection: " << strerror(errno) << std::endl;
+
+    acceptStats.queued = info.tcpi_unacked;
+    if (acceptStats.queued > acceptStats.queuedPeak)
+    {
+        acceptStats.queuedPeak = acceptStats.queued;
+        LOG_DEBUG("Listen queue at " << acceptStats.queued << "/" << acceptStats.backlog << " pending connections");
+    }
 }
 
-void Server::handleClient(int clientFd)
+void Server::logAcceptStats() const
 {
-    char buffer[512];
-    int bytesRead = recv(clientFd, buffer, sizeof(buffer) - 1, 0);
+    LOG_INFO("Connections accepted: " << acceptStats.accepted << ", rejected: " << acceptStats.rejected
+        << ", listen queue peak: " << acceptStats.queuedPeak << "/" << acceptStats.backlog);
+}
 
-    if (bytesRead > 0)
+void Server::acceptClient(int clientFd)
+{
+    acceptStats.sampleDue = true;
+    // The limit is for the whole server, whichever shard the kernel handed the connection to
+    if (group->clients.fetch_add(1) >= config.maxClients)
     {
-        buffer[bytesRead] = '\0';
-        clientBuffer[clientFd] += std::string(buffer, bytesRead);
+        group->clients.fetch_sub(1);
+        acceptStats.rejected++;
+        LOG_WARN("Maximum number of clients reached. Rejecting connection from client " << clientFd);
+        std::string response = "ERROR :Server full. Maximum number of clients reached.\r\n";
+        send(clientFd, response.c_str(), response.size(), MSG_NOSIGNAL);
+        reactor->disconnect(clientFd);
+        return;
+    }
 
-        auto now = std::chrono::system_clock::now();
-        std::time_t now_time = std::chrono::system_clock::to_time_t(now);
-        std::tm *now_tm = std::localtime(&now_time);
+    if (!reactor->add(clientFd, Reactor::READABLE))
+    {
+        group->clients.fetch_sub(1);
+        acceptStats.rejected++;
+        LOG_ERROR("Failed to register client " << clientFd << " with " << reactor->name());
+        reactor->disconnect(clientFd);
+        return;
+    }
+    connections.add(clientFd)->client.setHostname(hostname);
+    acceptStats.accepted++;
+    LOG_INFO("New client connected: " << clientFd);
+}
 
-        std::ostringstream time_stream;
-        time_stream << std::put_time(now_tm, "%Y-%m-%d %H:%M:%S");
+void Server::handleClient(int clientFd)
+{
+    Connection *connection = connections.get(clientFd);
+    if (!connection)
+        return;
+    // A closing connection only waits for its output; input is dropped so a level-triggered backend stops reporting it
+    if (connection->output.closing)
+    {
+        ssize_t bytesRead;
+        while ((bytesRead = recv(clientFd, recvScratch.data(), recvScratch.size(), 0)) > 0)
+            ;
+        if (bytesRead == 0 || (errno != EWOULDBLOCK && errno != EAGAIN && errno != EINTR))
+            removeClient(clientFd);
+        return;
+    }
+    // Already waiting for its turn this tick, the run queue reads the rest
+    if (connection->runQueued)
+    {
+        connection->socketUnread = true;
+        return;
+    }
 
-        std::cout << time_stream.str() << " >>>>>>>>>>>>>>>>>>>> Received from client " << clientFd << " >>> " << buffer << std::endl;
+    // Lines left over from the last turn go first, then fresh input while the budget lasts
+    size_t budget = config.tickLines;
+    connection->socketUnread = false;
+    if (!processLines(clientFd, connection->input, budget))
+        return;
 
-        size_t pos;
-        while ((pos = clientBuffer[clientFd].find('\n')) != std::string::npos)
+    while (true)
+    {
+        connection = connections.get(clientFd);
+        if (!connection)
+            return;
+        // Waiting for its commands on other shards, the socket is read again once they are done
+        if (connection->deferred)
+        {
+            connection->socketUnread = true;
+            return;
+        }
+        if (budget == 0)
         {
-            std::string command = clientBuffer[clientFd].substr(0, pos);
-            clientBuffer[clientFd].erase(0, pos + 1);
+            queueRunnable(clientFd, *connection);
+            connection->socketUnread = true;
+            return;
+        }
 
-            if (!command.empty() && command.back() == '\r') {
-                command.pop_back();
-            }
+        // Read into one shared buffer so a connection only ever holds the bytes it has not parsed yet
+        LineFramer &framer = connection->input;
+        char *buffer = recvScratch.data();
+        ssize_t bytesRead = recv(clientFd, buffer, recvScratch.size(), 0);
 
-            std::cout << "Client " << clientFd << ": " << command << std::endl;
-            handleIncomingMessage(command, clientFd);
+        if (bytesRead > 0)
+        {
+            framer.append(buffer, bytesRead);
+            LOG_TRAFFIC("Received from client " << clientFd << " >>> " << StringView(buffer, bytesRead));
+            if (!processLines(clientFd, framer, budget))
+                return;
+        }
+        else if (bytesRead == 0)
+        {
+            handleClientData(clientFd, NULL, 0);
+            return;
+        }
+        else
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EWOULDBLOCK || errno == EAGAIN)
+                return;
+            LOG_ERROR("Failed to receive message from " << clientFd << ": " << strerror(errno));
+            removeClient(clientFd);
+            return;
         }
     }
-    else if (bytesRead == 0)
+}
+
+bool Server::handleClientData(int clientFd, const char *data, size_t length)
+{
+    if (length == 0)
     {
-        std::cout << "Client " << clientFd << " disconnected" << std::endl;
+        LOG_INFO("Client " << clientFd << " disconnected");
         removeClient(clientFd);
+        return (false);
     }
-    else if (bytesRead == -1)
+
+    Connection *connection = connections.get(clientFd);
+    if (!connection || connection->output.closing)
+        return (false);
+
+    LineFramer &framer = connection->input;
+    framer.append(data, length);
+    LOG_TRAFFIC("Received from client " << clientFd << " >>> " << StringView(data, length));
+    // Completion backends cannot stop reading, a deferred connection catches up once it outgrows the receive queue
+    size_t budget = config.tickLines;
+    if (connection->runQueued)
     {
-        if (errno == EWOULDBLOCK || errno == EAGAIN)
-            return;
-        std::cerr << "Failed to receive message from " << clientFd << ": " << strerror(errno) << std::endl;
-        removeClient(clientFd);
+        if (framer.pending() <= config.recvqMax)
+            return (true);
+        budget = framer.pending();
     }
+    return (processLines(clientFd, framer, budget));
 }
 
-void Server::removeClient(int clientFd)
+void Server::queueRunnable(int clientFd, Connection &connection)
 {
-    close(clientFd);
+    if (connection.runQueued)
+        return;
+    connection.runQueued = true;
+    runQueue.push_back(connections.handle(clientFd));
+}
 
-    for (size_t i = pollfds.size(); i-- > 0;)
+// Connections that used their whole budget last tick continue where they stopped, in the order they ran out
+void Server::serveRunQueue(std::vector<ClientHandle> &carried)
+{
+    for (const ClientHandle &handle : carried)
     {
-        if (pollfds[i].fd == clientFd)
+        Connection *connection = connections.get(handle);
+        if (!connection)
+            continue;
+        connection->runQueued = false;
+        if (connection->socketUnread)
         {
-            pollfds.erase(pollfds.begin() + i);
-            break;
+            handleClient(handle.fd);
+            continue;
         }
+        size_t budget = config.tickLines;
+        processLines(handle.fd, connection->input, budget);
     }
+    carried.clear();
+}
 
-    clientBuffer.erase(clientFd);
+static long long monotonicMillis()
+{
+    return (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Token bucket: credit refills at floodRate lines a second up to floodBurst lines
+void Server::refillFlood(FloodBucket &flood, long long now) const
+{
+    long long capacity = config.floodBurst * FLOOD_UNIT;
+    long long credit = flood.refilledAt ? flood.credit + (now - flood.refilledAt) * config.floodRate : capacity;
 
-    clients.erase(std::remove_if(clients.begin(), clients.end(), [clientFd](const Client &client) {
-        return client.getClientFd() == clientFd;
-    }), clients.end());
+    flood.credit = static_cast<long>(std::min(credit, capacity));
+    flood.refilledAt = now;
+}
 
-    for (auto it = channels.begin(); it != channels.end();)
+// Answers each line the framer dropped for being over IRC_LINE_MAX with a 417
+void Server::reportOverflows(int clientFd, LineFramer &framer)
+{
+    for (unsigned dropped = framer.takeOverflows(); dropped > 0; dropped--)
     {
-        Channel &channel = it->second;
-        channel.removeMember(clientFd);
+        LOG_WARN("Dropped a line over " << IRC_LINE_MAX << " bytes from client " << clientFd);
+        sendReply(clientFd, numeric(clientFd, "417") << " :Input line was too long");
+    }
+}
 
-        if (channel.getMembers().empty())
+// Runs at most budget lines. Lines a connection has no credit for stay in its framer
+// until the bucket refills; a client that keeps sending past its receive queue is disconnected
+bool Server::processLines(int clientFd, LineFramer &framer, size_t &budget)
+{
+    Connection *connection = connections.get(clientFd);
+    if (!connection)
+        return (false);
+    FloodBucket &flood = connection->flood;
+    bool limited = (config.floodRate > 0);
+    if (limited)
+        refillFlood(flood, monotonicMillis());
+
+    StringView line;
+    while (budget > 0 && (!limited || flood.credit > 0) && !connection->output.closing && !connection->deferred && framer.next(line))
+    {
+        // next() skips overlong lines, so answer those before the line that followed them
+        reportOverflows(clientFd, framer);
+        budget--;
+        LOG_TRAFFIC("Client " << clientFd << ": " << line);
+        unsigned cost = handleIncomingMessage(line, clientFd);
+        // Stays in the framer until the client's commands on other shards are done, see Server::resume
+        if (cost == LINE_DEFERRED)
         {
-            std::cout << "Channel " << channel.getName() << " is now empty and has been removed" << std::endl;
-            it = channels.erase(it);
+            framer.rewind();
+            budget++;
+            connection->deferred = true;
+            break;
         }
-        else
-            ++it;
+        if (!getClient(clientFd))
+            return (false);
+        if (limited)
+            flood.credit -= cost * FLOOD_UNIT;
     }
 
-    std::cout << "Client " << clientFd << " removed" << std::endl;
+    reportOverflows(clientFd, framer);
+    if (connection->output.closing)
+        return (false);
+
+    // Lines held back by the tick budget are the server's doing, only a flood counts against the client
+    if (limited && flood.credit <= 0 && framer.pending() > config.recvqMax)
+    {
+        LOG_WARN("Client " << clientFd << " Excess Flood (" << framer.pending() << " bytes unparsed)");
+        closeLink(clientFd, connection->output, "Excess Flood");
+        return (false);
+    }
+    if (limited && flood.credit <= 0 && framer.pending() > 0 && !flood.throttled)
+    {
+        flood.throttled = true;
+        throttled.push_back(connections.handle(clientFd));
+    }
+    else if (budget == 0 && framer.pending() > 0 && !connection->deferred)
+        queueRunnable(clientFd, *connection);
+    framer.hibernate();
+    return (true);
 }
 
-void Server::closeServer()
+// Gives throttled connections their turn once they have credit again, returns the wait until the next one does
+int Server::resumeThrottled()
 {
-    for (size_t i = 0; i < pollfds.size(); i++)
+    if (throttled.empty())
+        return (-1);
+
+    long long now = monotonicMillis();
+    std::vector<ClientHandle> waiting;
+    waiting.swap(throttled);
+    for (const ClientHandle &handle : waiting)
     {
-        if (pollfds[i].fd != serverSocket)
-            close(pollfds[i].fd);
+        Connection *connection = connections.get(handle);
+        if (!connection)
+            continue;
+        refillFlood(connection->flood, now);
+        if (connection->flood.credit <= 0)
+        {
+            throttled.push_back(handle);
+            continue;
+        }
+        connection->flood.throttled = false;
+        size_t budget = config.tickLines;
+        processLines(handle.fd, connection->input, budget);
     }
-    close(serverSocket);
-    pollfds.clear();
-    clientBuffer.clear();
-    running = false;
+
+    long long wait = -1;
+    for (const ClientHandle &handle : throttled)
+    {
+        Connection *connection = connections.get(handle);
+        if (!connection)
+            continue;
+        long long ready = (config.floodRate - connection->flood.credit) / config.floodRate;
+        if (wait < 0 || ready < wait)
+            wait = ready;
+    }
+    return (static_cast<int>(wait));
 }
 
-void Server::sendMessage()
+// Totals are what a host has to be sized for, the largest entries show who is holding it
+void Server::logBufferStats()
 {
-    for (size_t i = pollfds.size(); i-- > 0;)
+    size_t inputBytes = 0, inputReserved = 0, outputBytes = 0, outputReserved = 0;
+    size_t largestInput = 0, largestOutput = 0;
+    int largestInputFd = -1, largestOutputFd = -1;
+
+    for (int clientFd : connections.fds())
     {
-        if (pollfds[i].revents & POLLOUT)
+        const Connection *connection = connections.get(clientFd);
+        size_t input = connection->input.capacity();
+        size_t output = connection->output.queue.size();
+
+        inputBytes += connection->input.pending();
+        inputReserved += input;
+        outputBytes += output;
+        outputReserved += connection->output.queue.reserved();
+        if (input > largestInput)
         {
-            int clientFd = pollfds[i].fd;
-            if (clientBuffer.find(clientFd) != clientBuffer.end() && !clientBuffer[clientFd].empty())
-            {
-                std::string &message = clientBuffer[clientFd];
-
-                ssize_t bytesSent = send(clientFd, message.c_str(), message.size(), 0);
-                if (bytesSent > 0)
-                {
-                    message.erase(0, bytesSent);
-                    if (message.empty())
-                    {
-                        clientBuffer[clientFd].clear();
-                        if (clientBuffer[clientFd].empty())
-                            pollfds[i].events &= ~POLLOUT;
-                    }
-                }
-                else if (errno != EWOULDBLOCK && errno != EAGAIN)
-                {
-                    std::cerr << "Failed to send message to " << clientFd << std::endl;
-                    removeClient(clientFd);
-                }
-            }
+            largestInput = input;
+            largestInputFd = clientFd;
         }
+        if (output > largestOutput)
+        {
+            largestOutput = output;
+            largestOutputFd = clientFd;
+        }
+        if (input > FRAMER_KEEP || output > config.sendqSoft)
+            LOG_DEBUG("Client " << clientFd << " buffers: input " << connection->input.pending() << "/" << input
+                << " bytes, output " << output << " bytes queued");
+    }
+
+    size_t count = connections.size();
+    LOG_INFO("Buffers for " << count << " connections: input " << inputBytes << " bytes unparsed, " << inputReserved
+        << " reserved; output " << outputBytes << " bytes queued, " << outputReserved << " reserved; "
+        << (count ? (inputReserved + outputReserved) / count : 0) << " bytes per connection; largest input "
+        << largestInput << " (fd " << largestInputFd << "), largest output " << largestOutput << " (fd " << largestOutputFd << ")");
+}
+
+void Server::removeClient(int clientFd)
+{
+    Connection *connection = connections.get(clientFd);
+    if (!connection)
+        return;
+
+    detachClient(connection->client);
+    flushClient(clientFd);
+    reactor->disconnect(clientFd);
+    connections.remove(clientFd);
+    group->clients.fetch_sub(1);
+
+    LOG_INFO("Client " << clientFd << " removed");
+}
+
+// Everything other clients can see of it, told to the shards that own it; safe to repeat
+void Server::detachClient(Client &client)
+{
+    if (client.isDetached())
+        return;
+    client.setDetached(true);
+    releaseNickname(client);
+    leaveAllChannels(client);
+    forgetInvites(client);
+}
+
+void Server::forgetInvites(Client &client)
+{
+    std::set<std::string> invited;
+    invited.swap(client.getInvitedChannels());
+
+    ClientRef ref = refOf(client.getClientFd());
+    for (const std::string &channelName : invited)
+    {
+        runOn(ownerOf(channelName), [ref, channelName](Server &owner) {
+            owner.uninvite(ref, channelName);
+        });
+    }
+}
+
+// Only the channels the client is in are touched, via its joinedChannels reverse index
+void Server::leaveAllChannels(Client &client)
+{
+    std::set<std::string> joined;
+    joined.swap(client.getJoinedChannels());
+
+    ClientRef ref = refOf(client.getClientFd());
+    for (const std::string &channelName : joined)
+    {
+        runOn(ownerOf(channelName), [ref, channelName](Server &owner) {
+            owner.leaveChannel(ref, channelName);
+        });
     }
 }
 
-void Server::messageBuffer(int clientFd, const std::string &message)
+void Server::closeServer()
+{
+    for (int clientFd : connections.fds())
+        reactor->disconnect(clientFd);
+    close(serverSocket);
+    for (int clientFd : acceptedQueue)
+        close(clientFd);
+    acceptedQueue.clear();
+    group->clients.fetch_sub(connections.size());
+    connections.clear();
+    nicknames.clear();
+    nickSuffixHint.clear();
+    suffixedNicks.clear();
+    pendingFlush.clear();
+    pendingClose.clear();
+    if (wakeFd >= 0)
+        close(wakeFd);
+    wakeFd = -1;
+    running = false;
+}
+
+static unsigned iovecBytes(const struct iovec *iov, int count)
+{
+    size_t bytes = 0;
+    for (int i = 0; i < count; i++)
+        bytes += iov[i].iov_len;
+    return (static_cast<unsigned>(bytes));
+}
+
+bool Server::flushClient(int clientFd)
 {
-    clientBuffer[clientFd] += message;
+    Connection *connection = connections.get(clientFd);
+    if (!connection)
+        return (true);
 
-    for (size_t i = 0; i < pollfds.size(); i++)
+    ClientOutput &output = connection->output;
+    struct iovec iov[OUTPUT_IOV_BATCH];
+    output.scheduled = false;
+
+    if (reactor->asyncWrites())
     {
-        if (pollfds[i].fd == clientFd)
+        if (!output.inFlight && !output.queue.empty())
         {
-            pollfds[i].events |= POLLOUT;
+            int count = output.queue.fillIovec(iov, OUTPUT_IOV_BATCH);
+            std::vector<SharedMessage> segments;
+            output.queue.pin(segments, count);
+            if (reactor->submitWrite(clientFd, iov, count, segments))
+                output.inFlight = iovecBytes(iov, count);
+        }
+        if (output.queue.size() <= config.sendqSoft)
+            output.behindSince = 0;
+        return (true);
+    }
+
+    while (!output.queue.empty())
+    {
+        ssize_t bytesSent = writev(clientFd, iov, output.queue.fillIovec(iov, OUTPUT_IOV_BATCH));
+        if (bytesSent > 0)
+            output.queue.consume(bytesSent);
+        else if (bytesSent == -1 && errno == EINTR)
+            continue;
+        else if (bytesSent == -1 && (errno == EWOULDBLOCK || errno == EAGAIN))
             break;
+        else
+        {
+            LOG_ERROR("Failed to send message to " << clientFd << ": " << strerror(errno));
+            return (false);
         }
     }
+
+    if (output.queue.size() <= config.sendqSoft)
+        output.behindSince = 0;
+
+    bool pending = !output.queue.empty();
+    if (pending != output.writeArmed)
+    {
+        reactor->modify(clientFd, pending ? Reactor::READABLE | Reactor::WRITABLE : Reactor::READABLE);
+        output.writeArmed = pending;
+    }
+    return (true);
+}
+
+void Server::flushPendingOutput()
+{
+    std::vector<ClientHandle> closing;
+    closing.swap(pendingClose);
+
+    // A closing client leaves its channels and nick at once, the connection stays until the ERROR line is out
+    time_t now = time(NULL);
+    for (const ClientHandle &handle : closing)
+    {
+        Connection *connection = connections.get(handle);
+        if (!connection)
+            continue;
+        ClientOutput &output = connection->output;
+        detachClient(connection->client);
+        if (!flushClient(handle.fd) || (output.queue.empty() && !output.inFlight) || now - output.closingSince >= config.sendqGrace)
+            removeClient(handle.fd);
+        else
+            pendingClose.push_back(handle);
+    }
+
+    std::vector<ClientHandle> scheduled;
+    scheduled.swap(pendingFlush);
+
+    for (const ClientHandle &handle : scheduled)
+    {
+        if (connections.get(handle) && !flushClient(handle.fd))
+            removeClient(handle.fd);
+    }
+
+    // Handlers are done with this tick, removed connections can be reused now
+    connections.reclaim();
 }
 
+void Server::handleWritten(int clientFd, size_t length)
+{
+    Connection *connection = connections.get(clientFd);
+    if (!connection)
+        return;
+
+    connection->output.inFlight = 0;
+    connection->output.queue.consume(length);
+    flushClient(clientFd);
+}
+
+// The first shard starts the others; they were marked running first, so an early stopShards still stops them
 void Server::run()
 {
-    std::cout << "Server running on port " << port << " with password " << password << std::endl;
-    running = true;
+    if (shardIndex == 0)
+    {
+        LOG_INFO("Server running on port " << port << " with password " << password);
+        running = true;
+        for (std::unique_ptr<Server> &peer : peers)
+        {
+            peer->running = true;
+            threads.push_back(std::thread(runShard, peer.get()));
+        }
+    }
+
+    std::vector<ReactorEvent> ready;
+    std::vector<ClientHandle> carried;
+    int idleWait = -1;
     while (running)
     {
-        int ret = poll(pollfds.data(), pollfds.size(), -1);
+        bool acceptsWaiting = acceptPending || !acceptedQueue.empty();
+        int ret = reactor->wait(ready, (acceptsWaiting || !runQueue.empty() || inboxBacklog) ? 0 : idleWait);
+        Log::tick();
         if (ret == -1)
         {
-            std::cerr << "Poll error: " << strerror(errno) << std::endl;
+            if (errno == EINTR)
+                continue;
+            LOG_ERROR("Poll error: " << strerror(errno));
             break;
         }
+        // Whatever runs out of budget from here on waits for the next tick
+        carried.swap(runQueue);
 
-        for (size_t i = 0; i < pollfds.size(); ++i)
+        for (const ReactorEvent &event : ready)
         {
-            if (pollfds[i].revents & POLLIN)
+            if (event.events & Reactor::ACCEPTED)
+            {
+                acceptedQueue.push_back(event.fd);
+                continue;
+            }
+            if (event.fd == serverSocket)
             {
-                if (pollfds[i].fd == serverSocket)
-                {
-                    handleConnections();
-                }
-                else
-                {
-                    handleClient(pollfds[i].fd);
-                }
+                acceptPending = true;
+                continue;
             }
+            if (event.fd == wakeFd)
+            {
+                uint64_t count;
+                while (read(wakeFd, &count, sizeof(count)) > 0)
+                    ;
+                continue;
+            }
+            if (event.events & Reactor::WRITTEN)
+                handleWritten(event.fd, event.length);
+            else if (event.events & Reactor::DATA)
+                handleClientData(event.fd, event.data, event.length);
+            else if (event.events & (Reactor::READABLE | Reactor::HANGUP))
+                handleClient(event.fd);
+            if ((event.events & Reactor::WRITABLE) && !flushClient(event.fd))
+                removeClient(event.fd);
+        }
+        drainInbox();
+        serveRunQueue(carried);
+        idleWait = resumeThrottled();
+        // Established clients get their turn first, then the next batch of new ones
+        if (acceptPending || !acceptedQueue.empty())
+            handleConnections();
+        if (acceptStats.sampleDue)
+            sampleListenQueue();
+        if (config.statsInterval > 0 && time(NULL) - lastBufferStats >= config.statsInterval)
+        {
+            lastBufferStats = time(NULL);
+            logBufferStats();
         }
+        flushPendingOutput();
+        wakePeers();
+        // Connections closing behind a slow reader are checked against their grace period once a second
+        if (!pendingClose.empty() && (idleWait < 0 || idleWait > 1000))
+            idleWait = 1000;
     }
 }
 
+// With the other shards stopped, their clients are removed from this thread
 void Server::cleanExit()
 {
-	for (const auto &pollfd : pollfds)
-	{
-		if (pollfd.fd != serverSocket)
-			removeClient(pollfd.fd);
-	}
+    stopShards();
+    for (Server *shard : group->servers)
+    {
+        std::vector<int> clientFds = shard->connections.fds();
+        for (int clientFd : clientFds)
+            shard->removeClient(clientFd);
+    }
 		
-    closeServer();
+    logCommandStats();
+    for (Server *shard : group->servers)
+    {
+        shard->logAcceptStats();
+        shard->closeServer();
+    }
     exit(EXIT_SUCCESS);
-}
\ No newline at end of file
+}
@@ -0,0 +1,374 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ServerShards.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 11:56:15 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 12:11:13 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Server.hpp"
+#include <pthread.h>
+#ifdef __linux__
+# include <sys/eventfd.h>
+#endif
+
+// Nicknames and channels belong to the shard their casemapped name hashes to
+unsigned Server::ownerOf(const StringView &name) const
+{
+    if (config.shards == 1)
+        return (0);
+
+    unsigned hash = 2166136261u;
+    for (size_t i = 0; i < name.size(); i++)
+        hash = (hash ^ static_cast<unsigned char>(ircFold(name.data()[i]))) * 16777619u;
+    return (hash % config.shards);
+}
+
+ClientRef Server::refOf(int clientFd) const
+{
+    ClientRef ref = { clientFd, connections.handle(clientFd).generation, shardIndex };
+    return (ref);
+}
+
+Connection *Server::connectionOf(const ClientRef &ref) const
+{
+    ClientHandle handle = { ref.fd, ref.generation };
+    return (connections.get(handle));
+}
+
+// Built on first use after NICK or USER changed the client, shared by every task that carries it
+const SharedCard &Server::cardOf(int clientFd)
+{
+    Client &client = connections.get(clientFd)->client;
+    if (!client.getCard())
+    {
+        ClientCard card = { refOf(clientFd), client.getNickname(), client.getUsername(), client.getRealname(), client.getPrefix() };
+        client.setCard(std::make_shared<const ClientCard>(card));
+    }
+    return (client.getCard());
+}
+
+// A command handed to another shard; it ends with exactly one finish(), wherever its last step runs
+void Server::beginOp(int clientFd)
+{
+    Connection *connection = connections.get(clientFd);
+    connection->awaiting++;
+    connection->awaitingShard = static_cast<unsigned char>(dispatchRoute);
+}
+
+void Server::finish(const ClientRef &ref)
+{
+    runOn(ref.shard, [ref](Server &home) {
+        home.resume(ref);
+    });
+}
+
+// Lines held back for this command are parsed again once nothing of the client is left in flight
+void Server::resume(const ClientRef &ref)
+{
+    Connection *connection = connectionOf(ref);
+    if (!connection || connection->awaiting == 0)
+        return;
+
+    if (--connection->awaiting == 0 && connection->deferred)
+    {
+        connection->deferred = false;
+        queueRunnable(ref.fd, *connection);
+    }
+}
+
+// Queued at once, so tasks reach a shard in the order they were sent; the wakeup waits for the end of the tick
+void Server::post(unsigned shard, const ShardTask &task)
+{
+    group->servers[shard]->inbox.push(task);
+    wakeDue[shard] = 1;
+}
+
+// At most SHARD_TASK_BATCH per tick, so a busy peer cannot starve this shard's own clients
+void Server::drainInbox()
+{
+    ShardTask task;
+    size_t count = 0;
+    while (count < SHARD_TASK_BATCH && inbox.pop(task))
+    {
+        task(*this);
+        count++;
+    }
+    inboxBacklog = (count == SHARD_TASK_BATCH);
+}
+
+void Server::wakePeers()
+{
+    const uint64_t one = 1;
+    for (size_t shard = 0; shard < wakeDue.size(); shard++)
+    {
+        if (!wakeDue[shard])
+            continue;
+        wakeDue[shard] = 0;
+        if (write(group->servers[shard]->wakeFd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+            LOG_WARN("Failed to wake shard " << shard << ": " << strerror(errno));
+    }
+}
+
+// Other shards write to it after queueing work here
+void Server::setupWakeup()
+{
+#ifdef __linux__
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+    if (wakeFd == -1 || !reactor->add(wakeFd, Reactor::READABLE))
+    {
+        LOG_ERROR("Failed to set up the wakeup descriptor of shard " << shardIndex << ": " << strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Signals go to the first shard, which stops the others
+void Server::runShard(Server *server)
+{
+    sigset_t blocked;
+    sigfillset(&blocked);
+    pthread_sigmask(SIG_BLOCK, &blocked, NULL);
+    server->run();
+}
+
+void Server::stopShards()
+{
+    const uint64_t one = 1;
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        peers[i]->running = false;
+        if (write(peers[i]->wakeFd, &one, sizeof(one)) == -1)
+            LOG_WARN("Failed to wake shard " << i + 1 << ": " << strerror(errno));
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    threads.clear();
+}
+
+// One task per shard for all of its recipients of a message
+void Server::sendOutgoing(const SharedMessage &message)
+{
+    for (unsigned shard = 0; shard < outgoing.size(); shard++)
+    {
+        if (outgoing[shard].empty())
+            continue;
+        std::vector<ClientRef> refs(outgoing[shard]);
+        outgoing[shard].clear();
+        post(shard, [refs, message](Server &home) {
+            home.deliver(refs, message);
+        });
+    }
+}
+
+void Server::deliver(const std::vector<ClientRef> &refs, const SharedMessage &message)
+{
+    size_t recipients = 0;
+    for (const ClientRef &ref : refs)
+    {
+        Connection *connection = connectionOf(ref);
+        if (connection && queueOutput(ref.fd, connection->output, message))
+            recipients++;
+    }
+
+    LOG_TRAFFIC("Sent to " << recipients << " clients for another shard >>> " << *message);
+}
+
+// The client's channels, grouped by the shard that owns them
+void Server::channelsByOwner(const Client &client, std::vector<unsigned> &shards, std::vector<std::vector<std::string> > &channelNames) const
+{
+    for (const std::string &channelName : client.getJoinedChannels())
+    {
+        unsigned shard = ownerOf(channelName);
+        size_t part = std::find(shards.begin(), shards.end(), shard) - shards.begin();
+        if (part == shards.size())
+        {
+            shards.push_back(shard);
+            channelNames.push_back(std::vector<std::string>());
+        }
+        channelNames[part].push_back(channelName);
+    }
+}
+
+// Each peer sharing any channel with the client gets one copy. The channels' shards name the members,
+// updating the client's card on the way or, when it is leaving, dropping it; this shard removes duplicates
+void Server::reachNeighbours(int clientFd, const SharedMessage &message, bool leaving, const ShardTask &done)
+{
+    Client &client = connections.get(clientFd)->client;
+    SharedCard card = cardOf(clientFd);
+    std::vector<unsigned> shards;
+    std::vector<std::vector<std::string> > channelNames;
+    channelsByOwner(client, shards, channelNames);
+    if (leaving)
+        client.getJoinedChannels().clear();
+
+    gather<std::vector<ClientRef> >(shards, [card, channelNames, leaving](Server &owner, size_t part) {
+        return (owner.collectNeighbours(card, channelNames[part], leaving));
+    }, [card, message, done](Server &home, std::vector<std::vector<ClientRef> > &answers) {
+        home.deliverOnce(answers, card->ref, message);
+        done(home);
+    });
+}
+
+std::vector<ClientRef> Server::collectNeighbours(const SharedCard &card, const std::vector<std::string> &channelNames, bool leaving)
+{
+    std::vector<ClientRef> neighbours;
+    for (const std::string &channelName : channelNames)
+    {
+        Channel *channel = getChannel(channelName);
+        if (!channel || !channel->isMember(card->ref))
+            continue;
+
+        for (const Membership &member : channel->getMembers())
+        {
+            if (member.ref != card->ref)
+                neighbours.push_back(member.ref);
+        }
+        if (!leaving)
+        {
+            channel->updateCard(card);
+            continue;
+        }
+        channel->removeMember(card->ref);
+        if (channel->getMembers().empty())
+        {
+            LOG_INFO("Channel " << channel->getName() << " is now empty and has been removed");
+            channels.destroy(*channel);
+        }
+    }
+    return (neighbours);
+}
+
+// Peers on this shard are stamped with the current epoch as they are visited, the others are sorted and deduplicated
+void Server::deliverOnce(std::vector<std::vector<ClientRef> > &answers, const ClientRef &self, const SharedMessage &message)
+{
+    if (++fanoutEpoch == 0)
+    {
+        for (int fd : connections.fds())
+            connections.get(fd)->fanoutEpoch = 0;
+        fanoutEpoch = 1;
+    }
+
+    Connection *own = connectionOf(self);
+    if (own)
+        own->fanoutEpoch = fanoutEpoch;
+
+    size_t recipients = 0;
+    for (const std::vector<ClientRef> &answer : answers)
+    {
+        for (const ClientRef &ref : answer)
+        {
+            if (ref.shard != shardIndex)
+            {
+                outgoing[ref.shard].push_back(ref);
+                continue;
+            }
+            Connection *connection = connectionOf(ref);
+            if (!connection || connection->fanoutEpoch == fanoutEpoch)
+                continue;
+            connection->fanoutEpoch = fanoutEpoch;
+            if (queueOutput(ref.fd, connection->output, message))
+                recipients++;
+        }
+    }
+    for (std::vector<ClientRef> &refs : outgoing)
+    {
+        std::sort(refs.begin(), refs.end(), [](const ClientRef &a, const ClientRef &b) { return (a.fd < b.fd); });
+        refs.erase(std::unique(refs.begin(), refs.end()), refs.end());
+        recipients += refs.size();
+    }
+    sendOutgoing(message);
+
+    LOG_TRAFFIC("Sent to " << recipients << " neighbours of client " << self.fd << " >>> " << *message);
+}
+
+// Channels keep their members' cards, a changed one goes to the shard of each channel the client is in
+void Server::publishCard(int clientFd)
+{
+    Client *client = getClient(clientFd);
+    if (!client || client->getJoinedChannels().empty())
+        return;
+
+    SharedCard card = cardOf(clientFd);
+    std::vector<unsigned> shards;
+    std::vector<std::vector<std::string> > channelNames;
+    channelsByOwner(*client, shards, channelNames);
+    for (size_t part = 0; part < shards.size(); part++)
+    {
+        std::vector<std::string> names = channelNames[part];
+        runOn(shards[part], [card, names](Server &owner) {
+            owner.updateCards(card, names);
+        });
+    }
+}
+
+void Server::updateCards(const SharedCard &card, const std::vector<std::string> &channelNames)
+{
+    for (const std::string &channelName : channelNames)
+    {
+        Channel *channel = getChannel(channelName);
+        if (channel)
+            channel->updateCard(card);
+    }
+}
+
+void Server::leaveChannel(const ClientRef &ref, const std::string &channelName)
+{
+    Channel *channel = getChannel(channelName);
+    if (!channel)
+        return;
+
+    channel->removeMember(ref);
+    if (channel->getMembers().empty())
+    {
+        LOG_INFO("Channel " << channel->getName() << " is now empty and has been removed");
+        channels.destroy(*channel);
+    }
+}
+
+void Server::uninvite(const ClientRef &ref, const std::string &channelName)
+{
+    Channel *channel = getChannel(channelName);
+    if (channel)
+        channel->uninviteUser(ref);
+}
+
+// The client's own record of its channels and invites follows what their shards decided.
+// A client that left the server meanwhile is taken back out
+void Server::joinedChannel(const ClientRef &ref, const std::string &channelName)
+{
+    Connection *connection = connectionOf(ref);
+    if (!connection || connection->client.isDetached())
+    {
+        runOn(ownerOf(channelName), [ref, channelName](Server &owner) {
+            owner.leaveChannel(ref, channelName);
+        });
+        return;
+    }
+    connection->client.joinChannel(channelName);
+}
+
+void Server::leftChannel(const ClientRef &ref, const std::string &channelName)
+{
+    Connection *connection = connectionOf(ref);
+    if (connection)
+        connection->client.leaveChannel(channelName);
+}
+
+void Server::invitedTo(const ClientRef &ref, const std::string &channelName, const SharedMessage &message)
+{
+    Connection *connection = connectionOf(ref);
+    if (!connection || connection->client.isDetached())
+    {
+        runOn(ownerOf(channelName), [ref, channelName](Server &owner) {
+            owner.uninvite(ref, channelName);
+        });
+        return;
+    }
+    connection->client.addInvite(channelName);
+    sendToClient(ref.fd, message);
+}
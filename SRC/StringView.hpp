@@ -0,0 +1,76 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   StringView.hpp                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 07:52:02 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 07:52:02 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#ifndef STRINGVIEW_HPP
+# define STRINGVIEW_HPP
+
+# include <cstring>
+# include <ostream>
+# include <string>
+
+// Non-owning view into a receive buffer, valid until the buffer is next modified
+class StringView
+{
+	private:
+		const char	*ptr;
+		size_t		len;
+
+	public:
+		static const size_t	npos = static_cast<size_t>(-1);
+
+		StringView() : ptr(""), len(0) {}
+		StringView(const char *data, size_t size) : ptr(data), len(size) {}
+		StringView(const char *str) : ptr(str), len(std::strlen(str)) {}
+		StringView(const std::string &str) : ptr(str.data()), len(str.size()) {}
+
+		const char	*data() const { return ptr; }
+		size_t		size() const { return len; }
+		bool		empty() const { return len == 0; }
+		char		operator[](size_t index) const { return ptr[index]; }
+		char		front() const { return ptr[0]; }
+		char		back() const { return ptr[len - 1]; }
+
+		void		removePrefix(size_t count) { ptr += count; len -= count; }
+		void		removeSuffix(size_t count) { len -= count; }
+
+		StringView	substr(size_t pos, size_t count = npos) const
+		{
+			if (pos > len)
+				pos = len;
+			if (count > len - pos)
+				count = len - pos;
+			return StringView(ptr + pos, count);
+		}
+
+		size_t		find(char c, size_t pos = 0) const
+		{
+			if (pos >= len)
+				return npos;
+			const void *found = std::memchr(ptr + pos, c, len - pos);
+			return found ? static_cast<const char *>(found) - ptr : npos;
+		}
+
+		std::string	str() const { return std::string(ptr, len); }
+
+		bool		operator==(const StringView &other) const
+		{
+			return len == other.len && std::memcmp(ptr, other.ptr, len) == 0;
+		}
+		bool		operator!=(const StringView &other) const { return !(*this == other); }
+};
+
+inline std::ostream	&operator<<(std::ostream &os, const StringView &view)
+{
+	return os.write(view.data(), view.size());
+}
+
+#endif
@@ -0,0 +1,505 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   UringReactor.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 07:16:20 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 11:41:51 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Reactor.hpp"
+
+#ifdef IRCSERV_HAVE_IO_URING
+
+# include <cerrno>
+# include <cstring>
+# include <cstdlib>
+# include <stdexcept>
+# include <sys/mman.h>
+# include <poll.h>
+# include <sys/socket.h>
+# include <sys/stat.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+
+# define URING_ENTRIES		1024
+# define URING_BUFFERS		256
+# define URING_BUFFER_SIZE	2048
+# define URING_BUFFER_GROUP	0
+
+enum
+{
+    OP_ACCEPT = 1,
+    OP_RECV,
+    OP_SEND,
+    OP_CANCEL,
+    OP_POLL
+};
+
+static uint64_t packUserData(unsigned op, unsigned generation, int fd)
+{
+    return ((static_cast<uint64_t>(op) << 56)
+        | (static_cast<uint64_t>(generation & 0xffffff) << 32)
+        | static_cast<uint32_t>(fd));
+}
+
+static unsigned userDataOp(uint64_t data) { return (static_cast<unsigned>(data >> 56)); }
+static unsigned userDataGeneration(uint64_t data) { return (static_cast<unsigned>(data >> 32) & 0xffffff); }
+static int userDataFd(uint64_t data) { return (static_cast<int>(data & 0xffffffff)); }
+
+static std::runtime_error uringError(const std::string &what)
+{
+    return (std::runtime_error("io_uring " + what + " failed: " + std::string(strerror(errno))));
+}
+
+UringReactor::UringReactor()
+    : ringFd(-1), sqRing(MAP_FAILED), cqRing(MAP_FAILED), sqes(static_cast<struct io_uring_sqe *>(MAP_FAILED)),
+      sqRingSize(0), cqRingSize(0), sqesSize(0), pendingSubmit(0),
+      bufRing(static_cast<struct io_uring_buf_ring *>(MAP_FAILED)), bufPool(nullptr),
+      bufCount(URING_BUFFERS), bufSize(URING_BUFFER_SIZE),
+      listenerFd(-1), multishotAccept(true), multishotRecv(true)
+{
+    try
+    {
+        setupRing(URING_ENTRIES);
+        probeOpcodes();
+        setupBufferRing();
+    }
+    catch (...)
+    {
+        release();
+        throw;
+    }
+}
+
+UringReactor::~UringReactor()
+{
+    release();
+}
+
+void UringReactor::release()
+{
+    if (bufRing != MAP_FAILED)
+        munmap(bufRing, bufCount * sizeof(struct io_uring_buf));
+    delete[] bufPool;
+    if (sqes != MAP_FAILED)
+        munmap(sqes, sqesSize);
+    if (cqRing != MAP_FAILED && cqRing != sqRing)
+        munmap(cqRing, cqRingSize);
+    if (sqRing != MAP_FAILED)
+        munmap(sqRing, sqRingSize);
+    if (ringFd != -1)
+        close(ringFd);
+    bufRing = static_cast<struct io_uring_buf_ring *>(MAP_FAILED);
+    bufPool = nullptr;
+    sqes = static_cast<struct io_uring_sqe *>(MAP_FAILED);
+    cqRing = sqRing = MAP_FAILED;
+    ringFd = -1;
+}
+
+void UringReactor::setupRing(unsigned entries)
+{
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+
+    ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ringFd == -1)
+        throw uringError("setup");
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG))
+    {
+        errno = ENOTSUP;
+        throw uringError("feature check");
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (cqRingSize > sqRingSize)
+        sqRingSize = cqRingSize;
+    cqRingSize = sqRingSize;
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+        throw uringError("ring mmap");
+    cqRing = sqRing;
+
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = static_cast<struct io_uring_sqe *>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED)
+        throw uringError("sqe mmap");
+
+    char *sq = static_cast<char *>(sqRing);
+    sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+    char *cq = static_cast<char *>(cqRing);
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+void UringReactor::probeOpcodes()
+{
+    const size_t probeSize = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    std::vector<char> storage(probeSize, 0);
+    struct io_uring_probe *probe = reinterpret_cast<struct io_uring_probe *>(storage.data());
+
+    if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, 256) == -1)
+        throw uringError("probe");
+
+    const unsigned char required[] = { IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG,
+        IORING_OP_ASYNC_CANCEL, IORING_OP_POLL_ADD };
+    for (unsigned char op : required)
+    {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+        {
+            errno = ENOTSUP;
+            throw uringError("opcode probe");
+        }
+    }
+}
+
+void UringReactor::setupBufferRing()
+{
+    size_t ringBytes = bufCount * sizeof(struct io_uring_buf);
+    void *ring = mmap(nullptr, ringBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED)
+        throw uringError("buffer ring mmap");
+    bufRing = static_cast<struct io_uring_buf_ring *>(ring);
+
+    struct io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufRing);
+    reg.ring_entries = bufCount;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+        throw uringError("provided buffer ring registration");
+
+    bufPool = new char[static_cast<size_t>(bufCount) * bufSize];
+    for (unsigned i = 0; i < bufCount; ++i)
+        usedBuffers.push_back(static_cast<unsigned short>(i));
+    bufRing->tail = 0;
+    recycleBuffers();
+}
+
+void UringReactor::recycleBuffers()
+{
+    if (usedBuffers.empty())
+        return;
+
+    unsigned short tail = bufRing->tail;
+    unsigned mask = bufCount - 1;
+    // The uapi flex array sits behind an empty struct, which is one byte wide in C++
+    for (size_t i = 0; i < usedBuffers.size(); ++i)
+    {
+        struct io_uring_buf *buf = reinterpret_cast<struct io_uring_buf *>(bufRing) + ((tail + i) & mask);
+        buf->addr = reinterpret_cast<uint64_t>(bufPool + static_cast<size_t>(usedBuffers[i]) * bufSize);
+        buf->len = bufSize;
+        buf->bid = usedBuffers[i];
+    }
+    __atomic_store_n(&bufRing->tail, static_cast<unsigned short>(tail + usedBuffers.size()), __ATOMIC_RELEASE);
+    usedBuffers.clear();
+}
+
+struct io_uring_sqe *UringReactor::nextSqe()
+{
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    unsigned tail = *sqTail;
+
+    if (tail - head > sqMask)
+    {
+        submit(0, 0);
+        head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (tail - head > sqMask)
+            return (nullptr);
+    }
+
+    unsigned index = tail & sqMask;
+    struct io_uring_sqe *sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    pendingSubmit++;
+    return (sqe);
+}
+
+int UringReactor::submit(unsigned waitFor, int timeoutMs)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned flags = IORING_ENTER_EXT_ARG;
+
+    std::memset(&arg, 0, sizeof(arg));
+    if (waitFor)
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeoutMs >= 0)
+        {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000000;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+        }
+    }
+
+    unsigned toSubmit = pendingSubmit;
+    int ret = static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, waitFor, flags, &arg, sizeof(arg)));
+    if (ret >= 0)
+        pendingSubmit -= (static_cast<unsigned>(ret) < toSubmit ? static_cast<unsigned>(ret) : toSubmit);
+    else if (errno == ETIME)
+        return (0);
+    return (ret);
+}
+
+unsigned UringReactor::generation(int fd)
+{
+    if (static_cast<size_t>(fd) >= generations.size())
+    {
+        generations.resize(fd + 1, 0);
+        receiving.resize(fd + 1, false);
+        writeSlots.resize(fd + 1);
+    }
+    return (generations[fd]);
+}
+
+void UringReactor::armAccept()
+{
+    struct io_uring_sqe *sqe = nextSqe();
+    if (!sqe)
+        return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenerFd;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    if (multishotAccept)
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = packUserData(OP_ACCEPT, 0, listenerFd);
+}
+
+void UringReactor::armRecv(int fd)
+{
+    struct io_uring_sqe *sqe = nextSqe();
+    if (!sqe)
+    {
+        starved.push_back(fd);
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    if (multishotRecv)
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = packUserData(OP_RECV, generation(fd), fd);
+    receiving[fd] = true;
+}
+
+void UringReactor::armPoll(int fd)
+{
+    struct io_uring_sqe *sqe = nextSqe();
+    if (!sqe)
+        return;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = packUserData(OP_POLL, generation(fd), fd);
+}
+
+bool UringReactor::addListener(int fd)
+{
+    listenerFd = fd;
+    armAccept();
+    return (submit(0, 0) >= 0);
+}
+
+bool UringReactor::add(int fd, unsigned events)
+{
+    (void)events;
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) == -1)
+        return (false);
+
+    generation(fd);
+    if (S_ISSOCK(info.st_mode))
+        armRecv(fd);
+    else
+        armPoll(fd);
+    return (true);
+}
+
+bool UringReactor::modify(int fd, unsigned events)
+{
+    (void)events;
+    return (fd >= 0);
+}
+
+void UringReactor::remove(int fd)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= generations.size())
+        return;
+
+    generations[fd] = (generations[fd] + 1) & 0xffffff;
+    receiving[fd] = false;
+
+    WriteSlot &slot = writeSlots[fd];
+    if (slot.inFlight)
+        slot.stale = true;
+    slot.retry = false;
+
+    struct io_uring_sqe *sqe = nextSqe();
+    if (!sqe)
+        return;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = packUserData(OP_CANCEL, 0, fd);
+    submit(0, 0);
+}
+
+bool UringReactor::submitWrite(int fd, const struct iovec *iov, int count, std::vector<SharedMessage> &segments)
+{
+    if (fd < 0)
+        return (false);
+    generation(fd);
+
+    WriteSlot &slot = writeSlots[fd];
+    if (slot.inFlight)
+    {
+        slot.retry = true;
+        return (false);
+    }
+
+    struct io_uring_sqe *sqe = nextSqe();
+    if (!sqe)
+        return (false);
+
+    slot.iov.assign(iov, iov + count);
+    slot.segments.swap(segments);
+    slot.message = msghdr();
+    slot.message.msg_iov = slot.iov.data();
+    slot.message.msg_iovlen = slot.iov.size();
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&slot.message);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = packUserData(OP_SEND, generation(fd), fd);
+    slot.inFlight = true;
+    return (true);
+}
+
+int UringReactor::wait(std::vector<ReactorEvent> &ready, int timeoutMs)
+{
+    ready.clear();
+    recycleBuffers();
+
+    std::vector<int> rearm;
+    rearm.swap(starved);
+    for (int fd : rearm)
+    {
+        if (static_cast<size_t>(fd) < receiving.size() && !receiving[fd])
+            armRecv(fd);
+    }
+
+    if (__atomic_load_n(cqTail, __ATOMIC_ACQUIRE) == *cqHead)
+    {
+        if (submit(1, timeoutMs) == -1)
+            return (-1);
+    }
+    else if (pendingSubmit && submit(0, 0) == -1)
+        return (-1);
+
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        const struct io_uring_cqe &cqe = cqes[head & cqMask];
+        unsigned op = userDataOp(cqe.user_data);
+        int fd = userDataFd(cqe.user_data);
+        bool more = cqe.flags & IORING_CQE_F_MORE;
+        bool current = static_cast<size_t>(fd) < generations.size()
+            && generations[fd] == userDataGeneration(cqe.user_data);
+
+        if (op == OP_ACCEPT)
+        {
+            if (cqe.res >= 0)
+                ready.push_back({cqe.res, ACCEPTED, nullptr, 0});
+            else if (cqe.res == -EINVAL && multishotAccept)
+                multishotAccept = false;
+            if (!more)
+                armAccept();
+        }
+        else if (op == OP_RECV)
+        {
+            char *data = nullptr;
+            if (cqe.flags & IORING_CQE_F_BUFFER)
+            {
+                unsigned short bid = static_cast<unsigned short>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                usedBuffers.push_back(bid);
+                data = bufPool + static_cast<size_t>(bid) * bufSize;
+            }
+            if (!current)
+                continue;
+            if (!more)
+                receiving[fd] = false;
+
+            if (cqe.res > 0)
+                ready.push_back({fd, DATA, data, static_cast<size_t>(cqe.res)});
+            else if (cqe.res == -ENOBUFS)
+            {
+                starved.push_back(fd);
+                continue;
+            }
+            else if (cqe.res == -EINVAL && multishotRecv)
+                multishotRecv = false;
+            else
+            {
+                ready.push_back({fd, DATA, nullptr, 0});
+                continue;
+            }
+            if (!more)
+                armRecv(fd);
+        }
+        else if (op == OP_POLL && current)
+        {
+            if (cqe.res >= 0)
+                ready.push_back({fd, READABLE, nullptr, 0});
+            if (!more && cqe.res != -ECANCELED)
+                armPoll(fd);
+        }
+        else if (op == OP_SEND && static_cast<size_t>(fd) < writeSlots.size())
+        {
+            WriteSlot &slot = writeSlots[fd];
+            slot.inFlight = false;
+            slot.segments.clear();
+            if (slot.stale)
+            {
+                slot.stale = false;
+                if (slot.retry)
+                {
+                    slot.retry = false;
+                    ready.push_back({fd, WRITTEN, nullptr, 0});
+                }
+            }
+            else if (cqe.res < 0 && cqe.res != -EAGAIN)
+                ready.push_back({fd, DATA, nullptr, 0});
+            else
+                ready.push_back({fd, WRITTEN, nullptr, static_cast<size_t>(cqe.res > 0 ? cqe.res : 0)});
+        }
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+    if (pendingSubmit)
+        submit(0, 0);
+    return (static_cast<int>(ready.size()));
+}
+
+#endif
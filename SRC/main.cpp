@@ -39,9 +39,11 @@ bool validPass(std::string str, std::string &password)
 
 void	signalHandler(int signal)
 {
+	// The cached time is from the last tick, which may be long ago on an idle server
+	Log::tick();
 	if (serverInstance)
 	{
-		std::cout << "\nSignal " << signal << " received. Stopping server..." << std::endl;
+		LOG_INFO("Signal " << signal << " received. Stopping server...");
 		serverInstance->cleanExit();
 	}
 	exit(signal);
@@ -69,21 +71,25 @@ int main(int argc, char **argv)
 		return (EXIT_FAILURE);
 	}
 		
+	ServerConfig config = ServerConfig::fromEnvironment();
+	Log::start(config.logLevel, config.logFile);
+
 	try
 	{
-		Server server(port, password);
+		Server server(port, password, config);
 		serverInstance = &server;
 		
 		signal(SIGINT, signalHandler);
 		signal(SIGTERM, signalHandler);
 		signal(SIGQUIT, signalHandler);
 		signal(SIGHUP, signalHandler);
+		signal(SIGPIPE, SIG_IGN);
 		
 		server.run();
 	}
 	catch (const std::exception &e)
 	{
-		std::cerr << "Server error: " << e.what() << std::endl;
+		LOG_ERROR("Server error: " << e.what());
 		return (EXIT_FAILURE);
 	}
 
@@ -0,0 +1,109 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   fanout_bench.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 10:37:18 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 11:57:45 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Channel.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// The std::set member and operator lists this layout replaced
+namespace legacy
+{
+    struct Channel
+    {
+        std::set<int>   members;
+        std::set<int>   operators;
+
+        bool isOperator(int clientFd) const { return operators.find(clientFd) != operators.end(); }
+    };
+}
+
+// Joins interleave with other allocations in a running server, so tree nodes land scattered
+static std::vector<std::unique_ptr<char[]>> churn;
+
+static void allocateBetweenJoins()
+{
+    churn.emplace_back(new char[16 + std::rand() % 240]);
+}
+
+template <typename Walk>
+static double run(unsigned long rounds, Walk walk)
+{
+    size_t checksum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned long round = 0; round < rounds; round++)
+        checksum += walk(static_cast<int>(round % 1000) + 4);
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (checksum == 0)
+        std::printf("unexpected empty walk\n");
+    return (elapsed / rounds);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long rounds = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 20000;
+    int memberCount = argc > 2 ? std::atoi(argv[2]) : 1000;
+
+    legacy::Channel before;
+    ::Channel after("#storm");
+    std::srand(42);
+    for (int fd = 4; fd < memberCount + 4; fd++)
+    {
+        before.members.insert(fd);
+        allocateBetweenJoins();
+        if (fd % 10 == 0)
+            before.operators.insert(fd);
+        allocateBetweenJoins();
+        ClientCard card = { { fd, 0, 0 }, "nick" + std::to_string(fd), "user", "real", "" };
+        after.addMember(std::make_shared<const ClientCard>(card), fd % 10 == 0 ? MEMBER_OP : 0);
+    }
+
+    // PRIVMSG fan-out: every member but the sender
+    double fanBefore = run(rounds, [&](int sender) {
+        size_t sum = 0;
+        for (int fd : before.members)
+            if (fd != sender)
+                sum += fd;
+        return (sum);
+    });
+    double fanAfter = run(rounds, [&](int sender) {
+        size_t sum = 0;
+        for (const Membership &member : after.getMembers())
+            if (member.ref.fd != sender)
+                sum += member.ref.fd;
+        return (sum);
+    });
+
+    // NAMES: every member with its operator flag
+    double namesBefore = run(rounds, [&](int) {
+        size_t sum = 0;
+        for (int fd : before.members)
+            sum += fd + before.isOperator(fd);
+        return (sum);
+    });
+    double namesAfter = run(rounds, [&](int) {
+        size_t sum = 0;
+        for (const Membership &member : after.getMembers())
+            sum += member.ref.fd + ((member.flags & MEMBER_OP) != 0);
+        return (sum);
+    });
+
+    std::printf("layout        fan-out ns/line  names ns/line  (%d members, %lu lines)\n", memberCount, rounds);
+    std::printf("std::set      %15.0f  %13.0f\n", fanBefore, namesBefore);
+    std::printf("flat vector   %15.0f  %13.0f\n", fanAfter, namesAfter);
+    std::printf("speedup       %14.1fx  %12.1fx\n", fanBefore / fanAfter, namesBefore / namesAfter);
+    return (0);
+}
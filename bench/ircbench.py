@@ -0,0 +1,138 @@
+"""Shared helpers for the load benchmarks.
+
+Starts an ircserv, holds fleets of registered idle clients in worker
+processes (so the bench is not capped by its own fd limit) and reads the
+server's CPU time and memory from /proc.
+"""
+
+import multiprocessing
+import os
+import resource
+import socket
+import subprocess
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+BINARY = os.environ.get('IRCSERV_BIN', os.path.join(ROOT, 'ircserv'))
+PASSWORD = 'bench'
+# Each loopback source address has its own ephemeral port range
+PER_SOURCE = 25000
+
+
+def raise_fd_limit():
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    resource.setrlimit(resource.RLIMIT_NOFILE, (hard, hard))
+    return hard
+
+
+def percentile(samples, fraction):
+    ordered = sorted(samples)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * fraction))]
+
+
+class Server:
+    def __init__(self, port, **settings):
+        environ = dict(os.environ)
+        environ.setdefault('IRCSERV_LOG_LEVEL', 'warn')
+        environ.setdefault('IRCSERV_STATS_INTERVAL', '0')
+        for name, value in settings.items():
+            environ['IRCSERV_' + name.upper()] = str(value)
+        self.port = port
+        self.log = open('/tmp/ircbench-%d.log' % port, 'w')
+        self.process = subprocess.Popen([BINARY, str(port), PASSWORD], stdout=self.log,
+                                        stderr=subprocess.STDOUT, env=environ)
+        deadline = time.time() + 5
+        while True:
+            try:
+                socket.create_connection(('127.0.0.1', port), timeout=1).close()
+                break
+            except OSError:
+                if time.time() > deadline or self.process.poll() is not None:
+                    raise RuntimeError('ircserv did not start on port %d' % port)
+                time.sleep(0.05)
+
+    def cpu_ns(self):
+        # Event loop thread only; the log writer runs on its own thread
+        with open('/proc/%d/task/%d/schedstat' % (self.process.pid, self.process.pid)) as stat:
+            return int(stat.read().split()[0])
+
+    def rss(self):
+        with open('/proc/%d/status' % self.process.pid) as status:
+            for line in status:
+                if line.startswith('VmRSS'):
+                    return int(line.split()[1]) * 1024
+        return 0
+
+    def alive(self):
+        return self.process.poll() is None
+
+    def stop(self):
+        self.process.kill()
+        self.process.wait()
+        self.log.close()
+
+
+def connect(port, nick, index=0, timeout=10):
+    sock = socket.socket()
+    sock.bind(('127.0.0.%d' % (2 + index // PER_SOURCE), 0))
+    sock.settimeout(timeout)
+    sock.connect(('127.0.0.1', port))
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    sock.sendall(b'PASS %s\r\nNICK %s\r\nUSER bench 0 * :bench\r\n' % (PASSWORD.encode(), nick.encode()))
+    return sock
+
+
+def read_until(sock, token, data=b''):
+    while token not in data:
+        chunk = sock.recv(65536)
+        if not chunk:
+            raise ConnectionError('connection closed before %r' % token)
+        data += chunk
+    return data
+
+
+def welcome(sock):
+    # Older builds send the numeric without a prefix, so match "001 " anywhere
+    return read_until(sock, b'001 ')
+
+
+def _hold(port, prefix, start, count, ready, done):
+    raise_fd_limit()
+    socks = []
+    registered = 0
+    try:
+        for index in range(start, start + count):
+            socks.append(connect(port, '%s%d' % (prefix, index), index))
+            if len(socks) % 500 == 0:
+                time.sleep(0.02)
+        for sock in socks:
+            welcome(sock)
+            registered += 1
+    except OSError:
+        pass
+    ready.send(registered)
+    done.recv()
+
+
+class IdleFleet:
+    """Registered clients that stay connected and silent until close()."""
+
+    def __init__(self, port, count, prefix='idle'):
+        per_worker = max(1, raise_fd_limit() - 256)
+        self.workers = []
+        self.registered = 0
+        for start in range(0, count, per_worker):
+            ready, ready_child = multiprocessing.Pipe()
+            done, done_child = multiprocessing.Pipe()
+            worker = multiprocessing.Process(target=_hold, args=(port, prefix, start, min(per_worker, count - start),
+                                                                  ready_child, done_child))
+            worker.start()
+            self.workers.append((worker, ready, done))
+        for worker, ready, done in self.workers:
+            self.registered += ready.recv()
+
+    def close(self):
+        for worker, ready, done in self.workers:
+            done.send(True)
+        for worker, ready, done in self.workers:
+            worker.join()
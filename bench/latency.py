@@ -0,0 +1,87 @@
+"""Round trip latency under pipelining load (per-tick line budget).
+
+HEAVY clients each join their own channel and pipeline PRIVMSG batches,
+with a WHO every 20 lines, as fast as the server takes them. Meanwhile
+a light client times ROUNDS PRIVMSG round trips to another light client.
+Without a per-connection budget a heavy client can hold the event loop,
+so the light round trips never come back.
+
+    python3 bench/latency.py           # BACKENDS=epoll,poll,io_uring HEAVY=4 ROUNDS=300
+"""
+
+import os
+import threading
+import time
+
+from ircbench import Server, connect, percentile, read_until, welcome
+
+BACKENDS = os.environ.get('BACKENDS', 'epoll,poll,io_uring').split(',')
+HEAVY = int(os.environ.get('HEAVY', '4'))
+ROUNDS = int(os.environ.get('ROUNDS', '300'))
+PORT = 6940
+
+
+def heavy(index, sockets):
+    sock = connect(PORT, 'heavy%d' % index)
+    sockets.append(sock)
+    try:
+        welcome(sock)
+        channel = b'#sink%d' % index
+        sock.sendall(b'JOIN %s\r\n' % channel)
+        threading.Thread(target=drain, args=(sock,), daemon=True).start()
+        batch = b''.join((b'WHO %s\r\n' % channel if line % 20 == 0 else b'')
+                         + b'PRIVMSG %s :%s\r\n' % (channel, b'x' * 200) for line in range(2000))
+        while True:
+            sock.sendall(batch)
+    except OSError:
+        pass
+
+
+def drain(sock):
+    try:
+        while sock.recv(1 << 20):
+            pass
+    except OSError:
+        pass
+
+
+def measure(backend):
+    server = Server(PORT, backend=backend, flood_rate=0)
+    sockets = []
+    for index in range(HEAVY):
+        threading.Thread(target=heavy, args=(index, sockets), daemon=True).start()
+    sender = connect(PORT, 'lighta')
+    receiver = connect(PORT, 'lightb')
+    latencies = []
+    try:
+        welcome(sender)
+        welcome(receiver)
+        time.sleep(1.0)
+        for round in range(ROUNDS):
+            start = time.perf_counter()
+            sender.sendall(b'PRIVMSG lightb :r%d\r\n' % round)
+            read_until(receiver, b':r%d\r\n' % round)
+            latencies.append(time.perf_counter() - start)
+            time.sleep(0.01)
+    except OSError:
+        pass
+
+    for sock in [sender, receiver] + sockets:
+        sock.close()
+    server.stop()
+    return latencies
+
+
+def main():
+    print('%-8s %8s %12s %12s %12s' % ('backend', 'answered', 'p50 ms', 'p99 ms', 'max ms'))
+    for backend in BACKENDS:
+        latencies = measure(backend)
+        if not latencies:
+            print('%-8s %8d %12s %12s %12s' % (backend, 0, '-', '-', '-'), flush=True)
+            continue
+        print('%-8s %8d %12.2f %12.2f %12.2f' % (backend, len(latencies), percentile(latencies, 0.5) * 1e3,
+                                                percentile(latencies, 0.99) * 1e3, max(latencies) * 1e3), flush=True)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,51 @@
+"""Per-line cost against connection count (connection table, nick index).
+
+Two active clients exchange PRIVMSGs by nickname while CONNECTIONS-2
+registered clients sit idle. Every line resolves the sender's fd and the
+target nick, so server CPU per line should stay flat from 10 to 10 000
+connections.
+
+    python3 bench/lookup.py            # CONNECTIONS=10,100,1000,10000 LINES=20000
+"""
+
+import os
+
+from ircbench import IdleFleet, Server, connect, read_until, welcome
+
+CONNECTIONS = [int(n) for n in os.environ.get('CONNECTIONS', '10,100,1000,10000').split(',')]
+LINES = int(os.environ.get('LINES', '20000'))
+BATCH = 200
+PORT = 6910
+
+
+def measure(connections):
+    server = Server(PORT, max_clients=connections + 100, flood_rate=0)
+    fleet = IdleFleet(PORT, max(0, connections - 2))
+    sender = connect(PORT, 'sender')
+    receiver = connect(PORT, 'receiver')
+    welcome(sender)
+    welcome(receiver)
+
+    before = server.cpu_ns()
+    for start in range(0, LINES, BATCH):
+        count = min(BATCH, LINES - start)
+        sender.sendall(b''.join(b'PRIVMSG receiver :line %d\r\n' % (start + i) for i in range(count)))
+        read_until(receiver, b':line %d\r\n' % (start + count - 1))
+    cpu = (server.cpu_ns() - before) / LINES
+
+    sender.close()
+    receiver.close()
+    fleet.close()
+    server.stop()
+    return fleet.registered + 2, cpu
+
+
+def main():
+    print('%12s %16s' % ('connections', 'server ns/line'))
+    for connections in CONNECTIONS:
+        registered, cpu = measure(connections)
+        print('%12d %16.0f' % (registered, cpu), flush=True)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,139 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   parser_bench.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 10:05:53 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 10:05:53 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Parsing.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Counts heap allocations so each parser reports how many a line costs
+static unsigned long allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *memory = std::malloc(size ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    return (memory);
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    std::free(memory);
+}
+
+// The istringstream parser this one replaced, kept verbatim as the baseline
+namespace legacy
+{
+    struct cmd_syntax {
+        std::string prefix;
+        std::string name;
+        std::vector<std::string> params;
+        std::string message;
+    };
+
+    cmd_syntax parseIrcMessage(const std::string& raw_msg)
+    {
+        cmd_syntax parsed;
+        std::istringstream stream(raw_msg);
+
+        if (raw_msg[0] == ':')
+        {
+            stream >> parsed.prefix;
+            parsed.prefix = parsed.prefix.substr(1);
+        }
+        stream >> parsed.name;
+
+        std::string param;
+        while (stream >> param) {
+            if (param[0] == ':') {
+                parsed.message = raw_msg.substr(raw_msg.find(param) + 1);
+                break;
+            } else {
+                parsed.params.push_back(param);
+            }
+        }
+        return parsed;
+    }
+}
+
+static const char *corpus[] = {
+    "PRIVMSG #general :hello everyone, how is it going today?",
+    ":nick!user@host PRIVMSG #general :a relayed message with a prefix",
+    "PING :irc.example.net",
+    "JOIN #general,#random key1,key2",
+    "MODE #general +ovl alice bob 25",
+    "KICK #general mallory :spamming the channel",
+    "NICK alice",
+    "USER alice 0 * :Alice Liddell",
+    "@time=2026-10-17T10:00:00.000Z;msgid=abc PRIVMSG #general :tagged",
+    "TOPIC #general :Welcome to the general channel, be nice",
+};
+
+#define CORPUS_SIZE (sizeof(corpus) / sizeof(corpus[0]))
+
+struct Result
+{
+    double			nsPerLine;
+    double			allocationsPerLine;
+};
+
+template <typename Parse>
+static Result run(unsigned long rounds, Parse parse)
+{
+    std::vector<std::string> lines(corpus, corpus + CORPUS_SIZE);
+    size_t checksum = 0;
+    unsigned long startAllocations = allocations;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (unsigned long round = 0; round < rounds; round++)
+        for (const std::string &line : lines)
+            checksum += parse(line);
+
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    double count = static_cast<double>(rounds * CORPUS_SIZE);
+    if (checksum == 0)
+        std::printf("unexpected empty parse\n");
+    Result result = { elapsed / count, (allocations - startAllocations) / count };
+    return (result);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long rounds = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 200000;
+
+    Result before = run(rounds, [](const std::string &line) {
+        legacy::cmd_syntax parsed = legacy::parseIrcMessage(line);
+        return parsed.name.size() + parsed.params.size() + parsed.message.size();
+    });
+    Result after = run(rounds, [](const std::string &line) {
+        cmd_syntax parsed;
+        parseIrcMessage(line, parsed);
+        return parsed.name.size() + parsed.params.size() + parsed.message.size();
+    });
+
+    std::printf("parser        ns/line  allocations/line  (%lu lines)\n", rounds * CORPUS_SIZE);
+    std::printf("istringstream %7.1f  %16.2f\n", before.nsPerLine, before.allocationsPerLine);
+    std::printf("single-pass   %7.1f  %16.2f\n", after.nsPerLine, after.allocationsPerLine);
+    std::printf("speedup       %7.1fx\n", before.nsPerLine / after.nsPerLine);
+    return (0);
+}
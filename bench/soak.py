@@ -0,0 +1,45 @@
+"""Idle connection soak (runtime client ceiling, per-connection memory).
+
+Holds CLIENTS registered idle clients on loopback, then checks that the
+server is still alive and answers a fresh client, and reports the
+server's RSS growth per client. The clients are spread over worker
+processes and loopback source addresses, so the bench itself is not
+capped by one process's fd limit or one ephemeral port range. The
+server still needs an RLIMIT_NOFILE hard limit above CLIENTS.
+
+    python3 bench/soak.py              # CLIENTS=100000
+"""
+
+import os
+import time
+
+from ircbench import IdleFleet, Server, connect, read_until, welcome
+
+CLIENTS = int(os.environ.get('CLIENTS', '100000'))
+PORT = 6930
+
+
+def main():
+    server = Server(PORT, max_clients=CLIENTS + 100, flood_rate=0)
+    base = server.rss()
+    start = time.time()
+    fleet = IdleFleet(PORT, CLIENTS)
+    elapsed = time.time() - start
+    grown = server.rss() - base
+
+    probe = connect(PORT, 'probe', CLIENTS)
+    welcome(probe)
+    probe.sendall(b'PING soak\r\n')
+    read_until(probe, b'soak')
+    probe.close()
+
+    alive = server.alive()
+    fleet.close()
+    server.stop()
+    print('%10s %10s %12s %16s %8s' % ('clients', 'registered', 'seconds', 'bytes/client', 'server'))
+    print('%10d %10d %12.1f %16.0f %8s' % (CLIENTS, fleet.registered, elapsed, grown / max(1, fleet.registered),
+                                          'alive' if alive else 'DIED'))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,77 @@
+"""Channel fan-out cost (member list layout).
+
+MEMBERS registered clients join one channel and keep draining their
+sockets while one more member sends LINES PRIVMSGs to the channel. Each
+line is copied to every other member, so server CPU per line is the cost
+of one fan-out over the member list.
+
+    python3 bench/storm.py             # MEMBERS=1000 LINES=2000
+"""
+
+import multiprocessing
+import os
+import selectors
+
+from ircbench import Server, connect, raise_fd_limit, read_until, welcome
+
+MEMBERS = int(os.environ.get('MEMBERS', '1000'))
+LINES = int(os.environ.get('LINES', '2000'))
+BATCH = 50
+PORT = 6920
+CHANNEL = b'#storm'
+
+
+def _member(port, start, count, ready, done):
+    raise_fd_limit()
+    socks = [connect(port, 'member%d' % index, index) for index in range(start, start + count)]
+    for sock in socks:
+        welcome(sock)
+        sock.sendall(b'JOIN %s\r\n' % CHANNEL)
+        read_until(sock, b'JOIN %s\r\n' % CHANNEL)
+        sock.setblocking(False)
+    ready.send(len(socks))
+    selector = selectors.DefaultSelector()
+    for sock in socks:
+        selector.register(sock, selectors.EVENT_READ)
+    while not done.poll():
+        for key, events in selector.select(timeout=0.1):
+            try:
+                key.fileobj.recv(65536)
+            except OSError:
+                pass
+
+
+def main():
+    server = Server(PORT, max_clients=MEMBERS + 100, flood_rate=0)
+    ready, ready_child = multiprocessing.Pipe()
+    done, done_child = multiprocessing.Pipe()
+    members = multiprocessing.Process(target=_member, args=(PORT, 0, MEMBERS - 2, ready_child, done_child))
+    members.start()
+    joined = ready.recv()
+
+    sender = connect(PORT, 'sender', MEMBERS)
+    receiver = connect(PORT, 'receiver', MEMBERS + 1)
+    for sock in (sender, receiver):
+        welcome(sock)
+        sock.sendall(b'JOIN %s\r\n' % CHANNEL)
+        read_until(sock, b'JOIN %s\r\n' % CHANNEL)
+
+    before = server.cpu_ns()
+    for start in range(0, LINES, BATCH):
+        count = min(BATCH, LINES - start)
+        sender.sendall(b''.join(b'PRIVMSG %s :storm %d\r\n' % (CHANNEL, start + i) for i in range(count)))
+        read_until(receiver, b':storm %d\r\n' % (start + count - 1))
+    cpu = (server.cpu_ns() - before) / LINES
+    alive = server.alive()
+
+    done.send(True)
+    members.join()
+    sender.close()
+    receiver.close()
+    server.stop()
+    print('%8s %14s %18s' % ('members', 'server us/line', 'server ns/delivery'))
+    print('%8d %14.1f %18.0f%s' % (joined + 2, cpu / 1000, cpu / (joined + 1), '' if alive else '  (server died)'))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,53 @@
+"""Wakeup cost against idle connections (reactor backends).
+
+One client pings the server over and over while IDLE registered clients
+sit silent. Each round trip is one event loop wakeup, so the server CPU
+time per round trip is the cost of a wakeup. With epoll it should stay
+flat as idle connections grow; poll() rescans every descriptor.
+
+    python3 bench/wakeup.py            # IDLE=0,1000,5000,15000 ROUNDS=5000
+"""
+
+import os
+import time
+
+from ircbench import IdleFleet, Server, connect, percentile, read_until, welcome
+
+IDLE = [int(n) for n in os.environ.get('IDLE', '0,1000,5000,15000').split(',')]
+ROUNDS = int(os.environ.get('ROUNDS', '5000'))
+BACKENDS = os.environ.get('BACKENDS', 'epoll,poll').split(',')
+PORT = 6900
+
+
+def measure(backend, idle):
+    server = Server(PORT, backend=backend, max_clients=idle + 100, flood_rate=0)
+    fleet = IdleFleet(PORT, idle)
+    pinger = connect(PORT, 'pinger')
+    welcome(pinger)
+
+    latencies = []
+    before = server.cpu_ns()
+    for round in range(ROUNDS):
+        token = b'w%d' % round
+        start = time.perf_counter()
+        pinger.sendall(b'PING ' + token + b'\r\n')
+        read_until(pinger, token)
+        latencies.append(time.perf_counter() - start)
+    cpu = (server.cpu_ns() - before) / ROUNDS
+
+    pinger.close()
+    fleet.close()
+    server.stop()
+    return fleet.registered, cpu / 1000, percentile(latencies, 0.5) * 1e6, percentile(latencies, 0.99) * 1e6
+
+
+def main():
+    print('%-8s %8s %16s %14s %14s' % ('backend', 'idle', 'server us/wake', 'p50 rtt us', 'p99 rtt us'))
+    for backend in BACKENDS:
+        for idle in IDLE:
+            registered, cpu, p50, p99 = measure(backend, idle)
+            print('%-8s %8d %16.2f %14.1f %14.1f' % (backend, registered, cpu, p50, p99), flush=True)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,46 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   casemap_test.cpp                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 10:23:14 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 10:23:14 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Casemap.hpp"
+#include <cstdio>
+
+static int failures = 0;
+
+static void expect(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        std::printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+int main()
+{
+    // RFC 1459: A-Z and []\^ are the upper case of a-z and {}|~
+    expect(ircEquals("NICK", "nick"), "A-Z folds to a-z");
+    expect(ircEquals("[]\\^", "{}|~"), "[]\\^ folds to {}|~");
+    expect(ircEquals("a^b", "a~b"), "^ and ~ are the same character");
+    expect(ircLower("Nick[^]") == "nick{~}", "ircLower folds [^]");
+    expect(ircLower("{}|~") == "{}|~", "lower case stays put");
+
+    // Nothing outside the table folds, and nothing folds onto 0x9E ('~' + 32)
+    expect(!ircEquals("~", "\x9e"), "~ does not fold to 0x9E");
+    expect(!ircEquals("@", "`"), "@ is not the upper case of `");
+    expect(!ircEquals("_", "\x7f"), "_ does not fold");
+    expect(!ircEquals("nick", "nick_"), "length differs");
+
+    if (failures)
+        return (1);
+    std::printf("casemap: ok\n");
+    return (0);
+}
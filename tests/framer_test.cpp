@@ -0,0 +1,69 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   framer_test.cpp                                    :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 11:20:00 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 11:20:00 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "LineFramer.hpp"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void expect(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        std::printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// Feeds the chunks in order and collects every line the framer hands out
+static std::vector<std::string> frame(const std::vector<std::string> &chunks, unsigned *overflows = NULL)
+{
+    LineFramer framer;
+    std::vector<std::string> lines;
+    StringView line;
+
+    for (const std::string &chunk : chunks)
+    {
+        framer.append(chunk.data(), chunk.size());
+        while (framer.next(line))
+            lines.push_back(line.str());
+    }
+    if (overflows)
+        *overflows = framer.takeOverflows();
+    return (lines);
+}
+
+int main()
+{
+    std::vector<std::string> expected = { "PING a", "PING b" };
+
+    expect(frame({ "PING a\r\nPING b\r\n" }) == expected, "CRLF ends a line");
+    expect(frame({ "PING a\nPING b\n" }) == expected, "LF ends a line");
+    expect(frame({ "PING a\rPING b\r" }) == expected, "bare CR ends a line");
+    expect(frame({ "PING a\r", "\nPING b\r", "\n" }) == expected, "CRLF split across reads is one terminator");
+    expect(frame({ "\r\n\n\rPING a\r\n\r\nPING b\n" }) == expected, "empty lines are skipped");
+    expect(frame({ "PING a", "\r\nPING b\r\nPING c" }) == expected, "an unterminated line waits");
+
+    // 510 bytes plus CRLF is the longest line; CR and LF each end a longer one as overlong
+    unsigned overflows = 0;
+    std::string longest(510, 'x');
+    expect(frame({ longest + "\r\n" }, &overflows) == std::vector<std::string>{ longest } && overflows == 0, "510 bytes + CRLF fits");
+    expect(frame({ longest + "x\rPING a\r\n" }, &overflows) == std::vector<std::string>{ "PING a" } && overflows == 1, "511 bytes + CR is dropped");
+    expect(frame({ std::string(600, 'x'), "\rPING a\n" }, &overflows) == std::vector<std::string>{ "PING a" } && overflows == 1, "overlong line is discarded up to its CR");
+
+    if (failures)
+        return (1);
+    std::printf("framer: ok\n");
+    return (0);
+}
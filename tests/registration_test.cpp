@@ -0,0 +1,78 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   registration_test.cpp                              :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: cesasanc <cesasanc@student.hive.fi>        +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/17 11:21:50 by cesasanc          #+#    #+#             */
+/*   Updated: 2026/10/17 11:21:50 by cesasanc         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+#include "Server.hpp"
+#include <cstdio>
+#include <sys/socket.h>
+
+static int failures = 0;
+
+static void expect(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        std::printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// Runs the lines as one tick of the event loop and returns what the client was sent
+static std::string exchange(Server &server, int serverFd, int clientFd, const std::vector<std::string> &lines)
+{
+    for (const std::string &line : lines)
+        server.handleIncomingMessage(StringView(line), serverFd);
+    server.flushPendingOutput();
+
+    std::string received;
+    char buffer[4096];
+    ssize_t length;
+    while ((length = recv(clientFd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0)
+        received.append(buffer, length);
+    return (received);
+}
+
+static bool contains(const std::string &text, const char *needle)
+{
+    return (text.find(needle) != std::string::npos);
+}
+
+int main()
+{
+    Log::start("error", "");
+    Server server(0, "pw");
+
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, pair) == -1)
+        return (1);
+    server.acceptClient(pair[0]);
+
+    // Commands that need a registered client answer 451 and do nothing else
+    std::string reply = exchange(server, pair[0], pair[1], { "PASS pw", "JOIN #early", "PRIVMSG #early :hi", "MODE #early +t" });
+    expect(contains(reply, " 451 * JOIN :You have not registered\r\n"), "JOIN before registration is 451");
+    expect(contains(reply, " 451 * PRIVMSG :You have not registered\r\n"), "PRIVMSG before registration is 451");
+    expect(contains(reply, " 451 * MODE :You have not registered\r\n"), "MODE before registration is 451");
+    expect(server.getChannel("#early") == NULL, "JOIN before registration creates no channel");
+
+    // Registration commands and PING are allowed before the welcome
+    reply = exchange(server, pair[0], pair[1], { "PING token", "NICK early", "USER early 0 * :Early Bird" });
+    expect(contains(reply, " PONG ") && !contains(reply, " 451 "), "PING before registration is answered");
+    expect(contains(reply, " 001 early :Welcome"), "NICK and USER complete registration");
+
+    reply = exchange(server, pair[0], pair[1], { "JOIN #early" });
+    expect(contains(reply, "JOIN #early\r\n") && server.getChannel("#early") != NULL, "JOIN after registration works");
+
+    close(pair[1]);
+    if (failures)
+        return (1);
+    std::printf("registration: ok\n");
+    return (0);
+}